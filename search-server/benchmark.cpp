@@ -0,0 +1,370 @@
+#include "benchmark_report.h"
+#include "corpus_generator.h"
+#include "corpus_loader.h"
+#include "durable_search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+using Clock = BenchmarkClock;
+
+struct BenchmarkOptions {
+    CorpusOptions corpus;
+    size_t match_samples = 1000;
+    double remove_ratio = 0.1;
+    SearchServerOptions server;
+    CorpusFormat load_format = CorpusFormat::TSV;
+    string output_path;
+};
+
+void PrintUsage() {
+    cerr << "Usage: search_server_benchmark [--documents=N] [--vocabulary=N] [--words-per-document=N]\n"
+            "       [--stop-words=N] [--zipf=S] [--duplicates=RATIO] [--queries=N] [--words-per-query=N]\n"
+            "       [--minus-probability=P] [--seed=N] [--match-samples=N] [--remove-ratio=RATIO]\n"
+            "       [--positional=0|1] [--impact-ordered=0|1] [--impact-budget=N] [--typos=0|1|2]\n"
+            "       [--load-format=tsv|jsonl] [--output=FILE]\n";
+}
+
+BenchmarkOptions ParseOptions(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const auto equals = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || equals == string::npos) {
+            PrintUsage();
+            exit(2);
+        }
+        const string name = argument.substr(2, equals - 2);
+        const string value = argument.substr(equals + 1);
+        if (name == "documents") {
+            options.corpus.document_count = stoul(value);
+        }
+        else if (name == "vocabulary") {
+            options.corpus.vocabulary_size = stoul(value);
+        }
+        else if (name == "words-per-document") {
+            options.corpus.words_per_document = stoul(value);
+        }
+        else if (name == "stop-words") {
+            options.corpus.stop_word_count = stoul(value);
+        }
+        else if (name == "zipf") {
+            options.corpus.zipf_exponent = stod(value);
+        }
+        else if (name == "duplicates") {
+            options.corpus.duplicate_ratio = stod(value);
+        }
+        else if (name == "queries") {
+            options.corpus.query_count = stoul(value);
+        }
+        else if (name == "words-per-query") {
+            options.corpus.words_per_query = stoul(value);
+        }
+        else if (name == "minus-probability") {
+            options.corpus.minus_word_probability = stod(value);
+        }
+        else if (name == "seed") {
+            options.corpus.seed = stoull(value);
+        }
+        else if (name == "match-samples") {
+            options.match_samples = stoul(value);
+        }
+        else if (name == "remove-ratio") {
+            options.remove_ratio = stod(value);
+        }
+        else if (name == "positional") {
+            options.server.positional_index = value == "1";
+        }
+        else if (name == "impact-ordered") {
+            options.server.impact_ordered_postings = value == "1";
+        }
+        else if (name == "impact-budget") {
+            options.server.max_impact_postings = stoul(value);
+        }
+        else if (name == "typos") {
+            options.server.max_typo_edits = stoul(value);
+        }
+        else if (name == "load-format") {
+            options.load_format = ParseCorpusFormat(value);
+        }
+        else if (name == "output") {
+            options.output_path = value;
+        }
+        else {
+            PrintUsage();
+            exit(2);
+        }
+    }
+    return options;
+}
+
+template <typename ExecutionPolicy>
+LatencySummary MeasureFindTopDocuments(const ExecutionPolicy& policy, const SearchServer& search_server, const vector<string>& queries) {
+    vector<uint64_t> samples;
+    samples.reserve(queries.size());
+    for (const string& query : queries) {
+        const auto start = Clock::now();
+        const auto documents = search_server.FindTopDocuments(policy, query);
+        samples.push_back(ElapsedNanoseconds(start));
+    }
+    return Summarize(move(samples));
+}
+
+// Megabytes of document text split into index terms per second.
+double MeasureTokenization(const SearchServer& search_server, const vector<string>& texts) {
+    size_t bytes = 0;
+    size_t words = 0;
+    const auto start = Clock::now();
+    for (const string& text : texts) {
+        words += search_server.TokenizeDocument(text).words.size();
+        bytes += text.size();
+    }
+    const double seconds = ElapsedNanoseconds(start) / 1e9;
+    return words > 0 ? bytes / 1e6 / seconds : 0.0;
+}
+
+// Synthetic words use every short spelling, so a typo inside a word mostly gives another
+// vocabulary word; an extra letter at the end gives a word missing from the index.
+vector<string> MisspellQueries(const vector<string>& queries) {
+    vector<string> misspelled;
+    misspelled.reserve(queries.size());
+    for (const string& query : queries) {
+        string text;
+        for (const string_view word : SplitIntoWords(query)) {
+            text += word;
+            text += word[0] == '-' ? " " : "z ";
+        }
+        misspelled.push_back(move(text));
+    }
+    return misspelled;
+}
+
+LatencySummary MeasureDeepPage(const SearchServer& search_server, const vector<string>& queries, size_t offset, size_t limit) {
+    vector<uint64_t> samples;
+    samples.reserve(queries.size());
+    for (const string& query : queries) {
+        const auto start = Clock::now();
+        const auto documents = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, offset, limit);
+        samples.push_back(ElapsedNanoseconds(start));
+    }
+    return Summarize(move(samples));
+}
+
+template <typename ExecutionPolicy>
+LatencySummary MeasureMatchDocument(const ExecutionPolicy& policy, const SearchServer& search_server, const vector<string>& queries, size_t sample_count) {
+    vector<uint64_t> samples;
+    if (queries.empty() || search_server.GetDocumentCount() == 0) {
+        return {};
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    samples.reserve(sample_count);
+    for (size_t i = 0; i < sample_count; ++i) {
+        const string& query = queries[i % queries.size()];
+        const int document_id = document_ids[(i * 7919) % document_ids.size()];
+        const auto start = Clock::now();
+        const auto result = search_server.MatchDocument(policy, query, document_id);
+        samples.push_back(ElapsedNanoseconds(start));
+    }
+    return Summarize(move(samples));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const BenchmarkOptions options = ParseOptions(argc, argv);
+    JsonReport report;
+
+    report.AddNumber("config", "documents", options.corpus.document_count);
+    report.AddNumber("config", "vocabulary", options.corpus.vocabulary_size);
+    report.AddNumber("config", "words_per_document", options.corpus.words_per_document);
+    report.AddNumber("config", "stop_words", options.corpus.stop_word_count);
+    report.AddNumber("config", "zipf_exponent", options.corpus.zipf_exponent);
+    report.AddNumber("config", "duplicate_ratio", options.corpus.duplicate_ratio);
+    report.AddNumber("config", "queries", options.corpus.query_count);
+    report.AddNumber("config", "words_per_query", options.corpus.words_per_query);
+    report.AddNumber("config", "seed", static_cast<double>(options.corpus.seed));
+    report.AddNumber("config", "positional_index", options.server.positional_index);
+    report.AddNumber("config", "impact_ordered_postings", options.server.impact_ordered_postings);
+    report.AddNumber("config", "max_impact_postings", options.server.max_impact_postings);
+    report.AddNumber("config", "max_typo_edits", options.server.max_typo_edits);
+    report.AddNumber("config", "timestamp", static_cast<double>(time(nullptr)));
+
+    auto start = Clock::now();
+    const SyntheticCorpus corpus = GenerateCorpus(options.corpus);
+    report.AddNumber("generation", "seconds", ElapsedNanoseconds(start) / 1e9);
+
+    SearchServer search_server(corpus.stop_words, options.server);
+
+    start = Clock::now();
+    for (const auto& document : corpus.documents) {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    const double ingestion_seconds = ElapsedNanoseconds(start) / 1e9;
+    report.AddNumber("add_document", "seconds", ingestion_seconds);
+    report.AddNumber("add_document", "documents_per_second", corpus.documents.size() / ingestion_seconds);
+    report.AddNumber("add_document", "words_per_second",
+        corpus.documents.size() * options.corpus.words_per_document / ingestion_seconds);
+    {
+        const SearchServerStats stats = search_server.GetStats();
+        report.AddNumber("index", "terms", stats.term_count);
+        report.AddNumber("index", "postings", stats.posting_count);
+        report.AddNumber("memory", "index_bytes", stats.total_bytes);
+        report.AddNumber("memory", "words_bytes", stats.words.bytes);
+        report.AddNumber("memory", "word_to_document_freqs_bytes", stats.word_to_document_freqs.bytes);
+        report.AddNumber("memory", "document_to_word_freqs_bytes", stats.document_to_word_freqs.bytes);
+        report.AddNumber("memory", "documents_bytes", stats.documents.bytes);
+        report.AddNumber("memory", "document_ids_bytes", stats.document_ids.bytes);
+        report.AddNumber("memory", "positional_index_bytes", stats.positions.bytes);
+        report.AddNumber("memory", "impact_ordered_postings_bytes", stats.impacts.bytes);
+        report.AddNumber("memory", "typo_index_bytes", stats.typos.bytes);
+        // Taken before the servers of the later sections exist, so the peak is the index under test.
+        report.AddNumber("memory", "peak_rss_kb", PeakResidentSetKilobytes());
+    }
+
+    {
+        // Lower-case ASCII takes the vectorized path; capitalized words have to be case folded.
+        vector<string> texts;
+        vector<string> capitalized_texts;
+        texts.reserve(corpus.documents.size());
+        capitalized_texts.reserve(corpus.documents.size());
+        for (const auto& document : corpus.documents) {
+            texts.push_back(document.text);
+            string& capitalized = capitalized_texts.emplace_back(document.text);
+            for (size_t i = 0; i < capitalized.size(); ++i) {
+                if (i == 0 || capitalized[i - 1] == ' ') {
+                    capitalized[i] = static_cast<char>(toupper(static_cast<unsigned char>(capitalized[i])));
+                }
+            }
+        }
+        report.AddNumber("tokenize", "ascii_megabytes_per_second", MeasureTokenization(search_server, texts));
+        report.AddNumber("tokenize", "capitalized_megabytes_per_second", MeasureTokenization(search_server, capitalized_texts));
+    }
+
+    {
+        // The same documents through the file pipeline: parsing and tokenizing run on all cores.
+        const filesystem::path corpus_path = filesystem::temp_directory_path()
+            / ("search_server_benchmark_"s + to_string(getpid()) + (options.load_format == CorpusFormat::TSV ? ".tsv"s : ".jsonl"s));
+        {
+            ofstream out(corpus_path);
+            WriteCorpus(out, corpus, options.load_format);
+        }
+        SearchServer loaded_server(corpus.stop_words, options.server);
+        CorpusLoadOptions load_options;
+        load_options.format = options.load_format;
+        const CorpusLoadProgress progress = LoadCorpus(loaded_server, corpus_path.string(), load_options);
+        filesystem::remove(corpus_path);
+        report.AddNumber("load_corpus", "seconds", progress.seconds);
+        report.AddNumber("load_corpus", "documents_per_second", progress.documents_loaded / progress.seconds);
+        report.AddNumber("load_corpus", "megabytes_per_second", progress.bytes_total / 1e6 / progress.seconds);
+    }
+
+    {
+        // Same ingestion with every mutation logged, flushed in the background every 10 ms.
+        const filesystem::path directory = filesystem::temp_directory_path() / ("search_server_benchmark_wal_"s + to_string(getpid()));
+        DurableSearchServerOptions durable_options;
+        durable_options.server = options.server;
+        durable_options.log.sync_on_commit = false;
+        durable_options.checkpoint_log_bytes = 0;
+        {
+            DurableSearchServer durable_server(directory.string(), corpus.stop_words, durable_options);
+            start = Clock::now();
+            for (const auto& document : corpus.documents) {
+                durable_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+            durable_server.Sync();
+            const double logged_seconds = ElapsedNanoseconds(start) / 1e9;
+            report.AddNumber("durable", "add_documents_per_second", corpus.documents.size() / logged_seconds);
+            report.AddNumber("durable", "logging_overhead_ratio", logged_seconds / ingestion_seconds - 1.0);
+            report.AddNumber("durable", "log_bytes", durable_server.GetLogSize());
+
+            start = Clock::now();
+            durable_server.Checkpoint();
+            report.AddNumber("durable", "checkpoint_seconds", ElapsedNanoseconds(start) / 1e9);
+            report.AddNumber("durable", "snapshot_bytes", filesystem::file_size(directory / "snapshot"));
+        }
+        start = Clock::now();
+        {
+            DurableSearchServer recovered_server(directory.string(), corpus.stop_words, durable_options);
+        }
+        report.AddNumber("durable", "recovery_seconds", ElapsedNanoseconds(start) / 1e9);
+        filesystem::remove_all(directory);
+    }
+
+    report.AddLatency("find_top_documents_seq", MeasureFindTopDocuments(execution::seq, search_server, corpus.queries));
+    report.AddLatency("find_top_documents_par", MeasureFindTopDocuments(execution::par, search_server, corpus.queries));
+
+    report.AddLatency("find_top_documents_page_50", MeasureDeepPage(search_server, corpus.queries, 490, 10));
+    if (options.server.max_typo_edits > 0) {
+        report.AddLatency("find_top_documents_typos", MeasureFindTopDocuments(execution::seq, search_server, MisspellQueries(corpus.queries)));
+    }
+
+    start = Clock::now();
+    const auto results = ProcessQueries(search_server, corpus.queries);
+    const double process_seconds = ElapsedNanoseconds(start) / 1e9;
+    report.AddNumber("process_queries", "seconds", process_seconds);
+    report.AddNumber("process_queries", "queries_per_second", results.size() / process_seconds);
+
+    report.AddLatency("match_document_seq", MeasureMatchDocument(execution::seq, search_server, corpus.queries, options.match_samples));
+    report.AddLatency("match_document_par", MeasureMatchDocument(execution::par, search_server, corpus.queries, options.match_samples));
+
+    {
+        // RemoveDuplicates reports every removed id on stdout, keep that out of the JSON.
+        ostringstream discarded;
+        auto* const previous_buffer = cout.rdbuf(discarded.rdbuf());
+        const int document_count = search_server.GetDocumentCount();
+        start = Clock::now();
+        RemoveDuplicates(search_server);
+        const double duplicates_seconds = ElapsedNanoseconds(start) / 1e9;
+        cout.rdbuf(previous_buffer);
+        report.AddNumber("remove_duplicates", "seconds", duplicates_seconds);
+        report.AddNumber("remove_duplicates", "removed", document_count - search_server.GetDocumentCount());
+    }
+
+    {
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const size_t remove_count = static_cast<size_t>(document_ids.size() * options.remove_ratio);
+        vector<uint64_t> samples;
+        samples.reserve(remove_count);
+        for (size_t i = 0; i < remove_count; ++i) {
+            const int document_id = document_ids[i * document_ids.size() / remove_count];
+            start = Clock::now();
+            if (i % 2 == 0) {
+                search_server.RemoveDocument(execution::seq, document_id);
+            }
+            else {
+                search_server.RemoveDocument(execution::par, document_id);
+            }
+            samples.push_back(ElapsedNanoseconds(start));
+        }
+        report.AddLatency("remove_document", Summarize(move(samples)));
+    }
+
+    if (options.output_path.empty()) {
+        report.Print(cout);
+    }
+    else {
+        ofstream out(options.output_path);
+        report.Print(out);
+    }
+    return 0;
+}
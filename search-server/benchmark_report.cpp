@@ -0,0 +1,76 @@
+#include "benchmark_report.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+std::uint64_t ElapsedNanoseconds(BenchmarkClock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - start).count();
+}
+
+LatencySummary Summarize(std::vector<std::uint64_t> samples) {
+    LatencySummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    const auto at = [&samples](double percentile) {
+        return samples[static_cast<size_t>(percentile / 100.0 * (samples.size() - 1))];
+    };
+    std::uint64_t sum = 0;
+    for (const std::uint64_t sample : samples) {
+        sum += sample;
+    }
+    summary.count = samples.size();
+    summary.mean_ns = sum / samples.size();
+    summary.p50_ns = at(50);
+    summary.p90_ns = at(90);
+    summary.p99_ns = at(99);
+    summary.max_ns = samples.back();
+    return summary;
+}
+
+void JsonReport::AddNumber(const std::string& section, const std::string& key, double value) {
+    // JSON has no NaN or infinity.
+    if (!std::isfinite(value)) {
+        sections_[section].emplace_back(key, "null");
+        return;
+    }
+    std::ostringstream out;
+    out.precision(12);
+    out << value;
+    sections_[section].emplace_back(key, out.str());
+}
+
+void JsonReport::AddLatency(const std::string& section, const LatencySummary& summary) {
+    AddNumber(section, "count", static_cast<double>(summary.count));
+    AddNumber(section, "mean_ns", static_cast<double>(summary.mean_ns));
+    AddNumber(section, "p50_ns", static_cast<double>(summary.p50_ns));
+    AddNumber(section, "p90_ns", static_cast<double>(summary.p90_ns));
+    AddNumber(section, "p99_ns", static_cast<double>(summary.p99_ns));
+    AddNumber(section, "max_ns", static_cast<double>(summary.max_ns));
+}
+
+void JsonReport::Print(std::ostream& out) const {
+    out << "{\n";
+    bool first_section = true;
+    for (const auto& [section, values] : sections_) {
+        out << (first_section ? "" : ",\n") << "  \"" << section << "\": {";
+        first_section = false;
+        bool first_value = true;
+        for (const auto& [key, value] : values) {
+            out << (first_value ? "" : ",") << "\n    \"" << key << "\": " << value;
+            first_value = false;
+        }
+        out << "\n  }";
+    }
+    out << "\n}\n";
+}
+
+long PeakResidentSetKilobytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
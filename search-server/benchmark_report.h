@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+std::uint64_t ElapsedNanoseconds(BenchmarkClock::time_point start);
+
+struct LatencySummary {
+    size_t count = 0;
+    std::uint64_t mean_ns = 0;
+    std::uint64_t p50_ns = 0;
+    std::uint64_t p90_ns = 0;
+    std::uint64_t p99_ns = 0;
+    std::uint64_t max_ns = 0;
+};
+
+LatencySummary Summarize(std::vector<std::uint64_t> samples);
+
+// Minimal JSON writer: the report is a flat object of sections holding numbers.
+class JsonReport {
+public:
+    void AddNumber(const std::string& section, const std::string& key, double value);
+
+    void AddLatency(const std::string& section, const LatencySummary& summary);
+
+    void Print(std::ostream& out) const;
+
+private:
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> sections_;
+};
+
+long PeakResidentSetKilobytes();
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Native byte order binary encoding for snapshots and the write-ahead log. The files are meant to be
+// read back on the machine that wrote them, not exchanged between architectures.
+
+template <typename T>
+void WriteBinary(std::ostream& out, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void WriteBinaryString(std::ostream& out, std::string_view text) {
+    WriteBinary(out, static_cast<std::uint32_t>(text.size()));
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+template <typename T>
+T ReadBinary(std::istream& in) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Unexpected end of binary data");
+    }
+    return value;
+}
+
+inline std::string ReadBinaryString(std::istream& in) {
+    std::string text(ReadBinary<std::uint32_t>(in), '\0');
+    if (!in.read(text.data(), static_cast<std::streamsize>(text.size()))) {
+        throw std::runtime_error("Unexpected end of binary data");
+    }
+    return text;
+}
+
+template <typename T>
+void AppendBinary(std::string& out, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void AppendBinaryString(std::string& out, std::string_view text) {
+    AppendBinary(out, static_cast<std::uint32_t>(text.size()));
+    out.append(text);
+}
+
+// Reads values written with AppendBinary; strings are views into the data.
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data)
+        : data_(data) {
+    }
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view ReadString() {
+        return Take(Read<std::uint32_t>());
+    }
+
+    bool AtEnd() const {
+        return data_.empty();
+    }
+
+private:
+    std::string_view data_;
+
+    std::string_view Take(size_t size) {
+        if (data_.size() < size) {
+            throw std::runtime_error("Unexpected end of binary data");
+        }
+        const std::string_view taken = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return taken;
+    }
+};
@@ -0,0 +1,128 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+ZipfDistribution::ZipfDistribution(size_t n, double exponent) {
+    if (n == 0) {
+        throw std::invalid_argument("Zipf distribution needs at least one value");
+    }
+    cdf_.reserve(n);
+    double sum = 0.0;
+    for (size_t rank = 0; rank < n; ++rank) {
+        sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+        cdf_.push_back(sum);
+    }
+}
+
+std::string MakeSyntheticWord(size_t rank) {
+    std::string word;
+    do {
+        word.push_back(static_cast<char>('a' + rank % 26));
+        rank /= 26;
+    } while (rank-- > 0);
+    std::reverse(word.begin(), word.end());
+    return word;
+}
+
+SyntheticCorpus GenerateCorpus(const CorpusOptions& options) {
+    if (options.vocabulary_size <= options.stop_word_count) {
+        throw std::invalid_argument("Vocabulary must be larger than the stop word list");
+    }
+
+    std::mt19937_64 generator(options.seed);
+    const ZipfDistribution word_distribution(options.vocabulary_size, options.zipf_exponent);
+    std::uniform_real_distribution<double> probability(0.0, 1.0);
+    std::uniform_int_distribution<int> rating_distribution(-10, 10);
+    std::uniform_int_distribution<int> rating_count_distribution(1, 5);
+
+    SyntheticCorpus corpus;
+
+    // The most frequent ranks play the role of "and", "with", "the".
+    for (size_t rank = 0; rank < options.stop_word_count; ++rank) {
+        if (rank > 0) {
+            corpus.stop_words.push_back(' ');
+        }
+        corpus.stop_words += MakeSyntheticWord(rank);
+    }
+
+    corpus.documents.reserve(options.document_count);
+    for (size_t i = 0; i < options.document_count; ++i) {
+        GeneratedDocument document;
+        document.id = static_cast<int>(i);
+
+        if (!corpus.documents.empty() && probability(generator) < options.duplicate_ratio) {
+            std::uniform_int_distribution<size_t> source_distribution(0, corpus.documents.size() - 1);
+            document.text = corpus.documents[source_distribution(generator)].text;
+        }
+        else {
+            for (size_t j = 0; j < options.words_per_document; ++j) {
+                if (j > 0) {
+                    document.text.push_back(' ');
+                }
+                document.text += MakeSyntheticWord(word_distribution(generator));
+            }
+        }
+
+        const double status_value = probability(generator);
+        if (status_value < 0.9) {
+            document.status = DocumentStatus::ACTUAL;
+        }
+        else if (status_value < 0.95) {
+            document.status = DocumentStatus::IRRELEVANT;
+        }
+        else {
+            document.status = DocumentStatus::BANNED;
+        }
+
+        const int rating_count = rating_count_distribution(generator);
+        for (int j = 0; j < rating_count; ++j) {
+            document.ratings.push_back(rating_distribution(generator));
+        }
+        corpus.documents.push_back(std::move(document));
+    }
+
+    corpus.queries.reserve(options.query_count);
+    for (size_t i = 0; i < options.query_count; ++i) {
+        std::string query;
+        for (size_t j = 0; j < options.words_per_query; ++j) {
+            if (j > 0) {
+                query.push_back(' ');
+                if (probability(generator) < options.minus_word_probability) {
+                    query.push_back('-');
+                }
+            }
+            query += MakeSyntheticWord(word_distribution(generator));
+        }
+        corpus.queries.push_back(std::move(query));
+    }
+
+    return corpus;
+}
+
+void WriteCorpus(std::ostream& out, const SyntheticCorpus& corpus, CorpusFormat format) {
+    for (const GeneratedDocument& document : corpus.documents) {
+        if (format == CorpusFormat::TSV) {
+            out << document.id << '\t' << static_cast<int>(document.status) << '\t';
+            for (size_t i = 0; i < document.ratings.size(); ++i) {
+                out << (i > 0 ? " " : "") << document.ratings[i];
+            }
+            out << '\t' << document.text << '\n';
+            continue;
+        }
+
+        out << "{\"id\": " << document.id << ", \"status\": " << static_cast<int>(document.status) << ", \"ratings\": [";
+        for (size_t i = 0; i < document.ratings.size(); ++i) {
+            out << (i > 0 ? ", " : "") << document.ratings[i];
+        }
+        out << "], \"text\": \"";
+        for (const char c : document.text) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << "\"}\n";
+    }
+}
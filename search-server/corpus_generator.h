@@ -0,0 +1,61 @@
+#pragma once
+
+#include "corpus_loader.h"
+#include "search_server.h"
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+struct CorpusOptions {
+    size_t document_count = 10000;
+    size_t vocabulary_size = 50000;
+    size_t words_per_document = 50;
+    size_t stop_word_count = 10;
+    double zipf_exponent = 1.0;
+    double duplicate_ratio = 0.01;
+    size_t query_count = 1000;
+    size_t words_per_query = 3;
+    double minus_word_probability = 0.1;
+    std::uint64_t seed = 42;
+};
+
+struct GeneratedDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct SyntheticCorpus {
+    std::string stop_words;
+    std::vector<GeneratedDocument> documents;
+    std::vector<std::string> queries;
+};
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent.
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double exponent);
+
+    template <typename Generator>
+    size_t operator()(Generator& generator) const {
+        const double value = std::uniform_real_distribution<double>(0.0, cdf_.back())(generator);
+        const auto it = std::upper_bound(cdf_.begin(), cdf_.end(), value);
+        return std::min(static_cast<size_t>(it - cdf_.begin()), cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+// Deterministic word for a vocabulary rank: 0 -> "a", 25 -> "z", 26 -> "aa", ...
+std::string MakeSyntheticWord(size_t rank);
+
+// The same options always produce the same corpus, so runs on different builds are comparable.
+SyntheticCorpus GenerateCorpus(const CorpusOptions& options);
+
+// Writes the documents in a format LoadCorpus reads back.
+void WriteCorpus(std::ostream& out, const SyntheticCorpus& corpus, CorpusFormat format);
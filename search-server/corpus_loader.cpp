@@ -0,0 +1,513 @@
+#include "corpus_loader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+int ParseInteger(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid integer \"" + std::string(text) + "\"");
+    }
+    return value;
+}
+
+const std::string_view STATUS_NAMES[] = { "ACTUAL", "IRRELEVANT", "BANNED", "REMOVED" };
+
+DocumentStatus ToDocumentStatus(int value) {
+    if (value < 0 || value >= static_cast<int>(std::size(STATUS_NAMES))) {
+        throw std::invalid_argument("Invalid document status " + std::to_string(value));
+    }
+    return static_cast<DocumentStatus>(value);
+}
+
+DocumentStatus ParseDocumentStatus(std::string_view text) {
+    for (size_t i = 0; i < std::size(STATUS_NAMES); ++i) {
+        if (text == STATUS_NAMES[i]) {
+            return static_cast<DocumentStatus>(i);
+        }
+    }
+    return ToDocumentStatus(ParseInteger(text));
+}
+
+std::vector<int> ParseRatings(std::string_view text) {
+    std::vector<int> ratings;
+    while (!text.empty()) {
+        const auto space = text.find(' ');
+        const std::string_view rating = text.substr(0, space);
+        if (!rating.empty()) {
+            ratings.push_back(ParseInteger(rating));
+        }
+        text.remove_prefix(space == text.npos ? text.size() : space + 1);
+    }
+    return ratings;
+}
+
+CorpusRecord ParseTsvRecord(std::string_view line) {
+    std::string_view fields[3];
+    for (std::string_view& field : fields) {
+        const auto tab = line.find('\t');
+        if (tab == line.npos) {
+            throw std::invalid_argument("Expected 4 tab-separated fields");
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    CorpusRecord record;
+    record.id = ParseInteger(fields[0]);
+    record.status = ParseDocumentStatus(fields[1]);
+    record.ratings = ParseRatings(fields[2]);
+    record.text = line;
+    return record;
+}
+
+void AppendUtf8(std::string& out, std::uint32_t code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// Reads the flat objects of the JSONL format in place, strings without escapes are returned as views.
+class JsonLineParser {
+public:
+    explicit JsonLineParser(std::string_view line)
+        : line_(line) {
+    }
+
+    bool AtEnd() {
+        SkipSpace();
+        return position_ == line_.size();
+    }
+
+    bool TryConsume(char c) {
+        SkipSpace();
+        if (position_ < line_.size() && line_[position_] == c) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c) {
+        if (!TryConsume(c)) {
+            throw std::invalid_argument(std::string("Expected '") + c + "' in JSON record");
+        }
+    }
+
+    // Unescaped strings are viewed in place, otherwise decoded into scratch.
+    std::string_view ParseString(std::string& scratch) {
+        Expect('"');
+        const size_t begin = position_;
+        while (position_ < line_.size() && line_[position_] != '"' && line_[position_] != '\\') {
+            ++position_;
+        }
+        if (position_ < line_.size() && line_[position_] == '"') {
+            return line_.substr(begin, position_++ - begin);
+        }
+
+        scratch.assign(line_.substr(begin, position_ - begin));
+        while (position_ < line_.size() && line_[position_] != '"') {
+            const char c = line_[position_++];
+            if (c != '\\') {
+                scratch += c;
+                continue;
+            }
+            if (position_ == line_.size()) {
+                break;
+            }
+            switch (const char escaped = line_[position_++]) {
+                case '"': case '\\': case '/': scratch += escaped; break;
+                case 'b': scratch += '\b'; break;
+                case 'f': scratch += '\f'; break;
+                case 'n': scratch += '\n'; break;
+                case 'r': scratch += '\r'; break;
+                case 't': scratch += '\t'; break;
+                case 'u': {
+                    std::uint32_t code_point = ParseHex4();
+                    // Characters above U+FFFF come as a high surrogate and a low one; either
+                    // half alone is not a character.
+                    if (code_point >= 0xDC00 && code_point < 0xE000) {
+                        throw std::invalid_argument("Unpaired surrogate in JSON string");
+                    }
+                    if (code_point >= 0xD800 && code_point < 0xDC00) {
+                        if (line_.substr(position_, 2) != "\\u") {
+                            throw std::invalid_argument("Unpaired surrogate in JSON string");
+                        }
+                        position_ += 2;
+                        const std::uint32_t low = ParseHex4();
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            throw std::invalid_argument("Unpaired surrogate in JSON string");
+                        }
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(scratch, code_point);
+                    break;
+                }
+                default:
+                    throw std::invalid_argument("Invalid escape in JSON string");
+            }
+        }
+        Expect('"');
+        return scratch;
+    }
+
+    int ParseInt() {
+        SkipSpace();
+        const size_t begin = position_;
+        while (position_ < line_.size() && (line_[position_] == '-' || (line_[position_] >= '0' && line_[position_] <= '9'))) {
+            ++position_;
+        }
+        return ParseInteger(line_.substr(begin, position_ - begin));
+    }
+
+    bool PeekString() {
+        SkipSpace();
+        return position_ < line_.size() && line_[position_] == '"';
+    }
+
+    void SkipValue() {
+        SkipSpace();
+        if (position_ == line_.size()) {
+            throw std::invalid_argument("Unexpected end of JSON record");
+        }
+        const char c = line_[position_];
+        if (c == '"') {
+            std::string scratch;
+            ParseString(scratch);
+        }
+        else if (c == '[' || c == '{') {
+            const char close = c == '[' ? ']' : '}';
+            ++position_;
+            if (TryConsume(close)) {
+                return;
+            }
+            do {
+                if (close == '}') {
+                    std::string scratch;
+                    ParseString(scratch);
+                    Expect(':');
+                }
+                SkipValue();
+            } while (TryConsume(','));
+            Expect(close);
+        }
+        else {
+            // Numbers, true, false and null.
+            while (position_ < line_.size() && std::string_view(",]} \t").find(line_[position_]) == std::string_view::npos) {
+                ++position_;
+            }
+        }
+    }
+
+private:
+    std::string_view line_;
+    size_t position_ = 0;
+
+    void SkipSpace() {
+        while (position_ < line_.size() && (line_[position_] == ' ' || line_[position_] == '\t' || line_[position_] == '\r')) {
+            ++position_;
+        }
+    }
+
+    std::uint32_t ParseHex4() {
+        if (line_.size() - position_ < 4) {
+            throw std::invalid_argument("Invalid \\u escape in JSON string");
+        }
+        std::uint32_t value = 0;
+        const auto [end, error] = std::from_chars(line_.data() + position_, line_.data() + position_ + 4, value, 16);
+        if (error != std::errc() || end != line_.data() + position_ + 4) {
+            throw std::invalid_argument("Invalid \\u escape in JSON string");
+        }
+        position_ += 4;
+        return value;
+    }
+};
+
+CorpusRecord ParseJsonlRecord(std::string_view line, std::string& decoded_text) {
+    JsonLineParser parser(line);
+    CorpusRecord record;
+    bool has_id = false;
+    bool has_text = false;
+    std::string scratch;
+
+    parser.Expect('{');
+    if (!parser.TryConsume('}')) {
+        do {
+            const std::string key(parser.ParseString(scratch));
+            parser.Expect(':');
+            if (key == "id") {
+                record.id = parser.ParseInt();
+                has_id = true;
+            }
+            else if (key == "status") {
+                record.status = parser.PeekString()
+                    ? ParseDocumentStatus(parser.ParseString(scratch))
+                    : ToDocumentStatus(parser.ParseInt());
+            }
+            else if (key == "ratings") {
+                parser.Expect('[');
+                if (!parser.TryConsume(']')) {
+                    do {
+                        record.ratings.push_back(parser.ParseInt());
+                    } while (parser.TryConsume(','));
+                    parser.Expect(']');
+                }
+            }
+            else if (key == "text") {
+                record.text = parser.ParseString(decoded_text);
+                has_text = true;
+            }
+            else {
+                parser.SkipValue();
+            }
+        } while (parser.TryConsume(','));
+        parser.Expect('}');
+    }
+    if (!parser.AtEnd()) {
+        throw std::invalid_argument("Unexpected characters after JSON record");
+    }
+    if (!has_id || !has_text) {
+        throw std::invalid_argument("JSON record needs \"id\" and \"text\"");
+    }
+    return record;
+}
+
+std::vector<std::string_view> SplitIntoChunks(std::string_view contents, size_t chunk_bytes) {
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    while (begin < contents.size()) {
+        size_t end = std::min(begin + chunk_bytes, contents.size());
+        const auto newline = contents.find('\n', end == 0 ? 0 : end - 1);
+        end = newline == contents.npos ? contents.size() : newline + 1;
+        chunks.push_back(contents.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+struct ParsedDocument {
+    CorpusRecord record;
+    TokenizedDocument tokens;
+    const char* line = nullptr;
+};
+
+struct ParsedChunk {
+    std::vector<ParsedDocument> documents;
+    // Decoded texts of escaped JSON strings; deque elements never move, so views into them stay valid.
+    std::deque<std::string> decoded_texts;
+    std::exception_ptr error;
+    const char* error_line = nullptr;
+};
+
+ParsedChunk ParseChunk(const SearchServer& search_server, std::string_view chunk, CorpusFormat format) {
+    ParsedChunk parsed;
+    std::string decoded_text;
+    while (!chunk.empty()) {
+        const auto newline = chunk.find('\n');
+        std::string_view line = chunk.substr(0, newline);
+        chunk.remove_prefix(newline == chunk.npos ? chunk.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        try {
+            ParsedDocument document;
+            document.line = line.data();
+            decoded_text.clear();
+            document.record = ParseCorpusRecord(line, format, decoded_text);
+            if (!decoded_text.empty() && document.record.text.data() == decoded_text.data()) {
+                document.record.text = parsed.decoded_texts.emplace_back(std::move(decoded_text));
+                decoded_text = std::string();
+            }
+            document.tokens = search_server.TokenizeDocument(document.record.text);
+            parsed.documents.push_back(std::move(document));
+        }
+        catch (...) {
+            parsed.error = std::current_exception();
+            parsed.error_line = line.data();
+            break;
+        }
+    }
+    return parsed;
+}
+
+// Runs parser threads over the chunks; Take hands the parsed chunks to the indexer in file order.
+class ChunkPipeline {
+public:
+    ChunkPipeline(const SearchServer& search_server, const std::vector<std::string_view>& chunks,
+                  const CorpusLoadOptions& options, size_t thread_count)
+        : search_server_(search_server)
+        , chunks_(chunks)
+        , options_(options)
+    {
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this] { RunParser(); });
+        }
+    }
+
+    ~ChunkPipeline() {
+        {
+            std::lock_guard guard(mutex_);
+            cancelled_ = true;
+        }
+        slot_free_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    ParsedChunk Take(size_t index) {
+        std::unique_lock lock(mutex_);
+        chunk_parsed_.wait(lock, [this, index] { return parsed_.count(index) > 0; });
+        auto node = parsed_.extract(index);
+        next_to_index_ = index + 1;
+        lock.unlock();
+        slot_free_.notify_all();
+        return std::move(node.mapped());
+    }
+
+private:
+    const SearchServer& search_server_;
+    const std::vector<std::string_view>& chunks_;
+    const CorpusLoadOptions& options_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable chunk_parsed_;
+    std::condition_variable slot_free_;
+    std::map<size_t, ParsedChunk> parsed_;
+    size_t next_to_parse_ = 0;
+    size_t next_to_index_ = 0;
+    bool cancelled_ = false;
+
+    void RunParser() {
+        const size_t max_in_flight = std::max<size_t>(options_.max_chunks_in_flight, 1);
+        while (true) {
+            size_t index = 0;
+            {
+                std::unique_lock lock(mutex_);
+                slot_free_.wait(lock, [this, max_in_flight] {
+                    return cancelled_ || next_to_parse_ >= chunks_.size() || next_to_parse_ < next_to_index_ + max_in_flight;
+                });
+                if (cancelled_ || next_to_parse_ >= chunks_.size()) {
+                    return;
+                }
+                index = next_to_parse_++;
+            }
+            ParsedChunk chunk = ParseChunk(search_server_, chunks_[index], options_.format);
+            {
+                std::lock_guard guard(mutex_);
+                parsed_.emplace(index, std::move(chunk));
+            }
+            chunk_parsed_.notify_all();
+        }
+    }
+};
+
+// Only called on failure, counting lines up front would cost a pass over the whole file.
+[[noreturn]] void RethrowWithLine(std::exception_ptr error, std::string_view contents, const char* line) {
+    const size_t line_number = 1 + std::count(contents.data(), line, '\n');
+    try {
+        std::rethrow_exception(error);
+    }
+    catch (const std::invalid_argument& e) {
+        throw std::invalid_argument("Line " + std::to_string(line_number) + ": " + e.what());
+    }
+    catch (const std::out_of_range& e) {
+        throw std::out_of_range("Line " + std::to_string(line_number) + ": " + e.what());
+    }
+    catch (const std::exception& e) {
+        throw std::runtime_error("Line " + std::to_string(line_number) + ": " + e.what());
+    }
+}
+
+}  // namespace
+
+CorpusFormat ParseCorpusFormat(std::string_view name) {
+    if (name == "tsv") {
+        return CorpusFormat::TSV;
+    }
+    if (name == "jsonl") {
+        return CorpusFormat::JSONL;
+    }
+    throw std::invalid_argument("Unknown corpus format \"" + std::string(name) + "\"");
+}
+
+CorpusRecord ParseCorpusRecord(std::string_view line, CorpusFormat format, std::string& decoded_text) {
+    if (format == CorpusFormat::TSV) {
+        return ParseTsvRecord(line);
+    }
+    return ParseJsonlRecord(line, decoded_text);
+}
+
+CorpusLoadProgress LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile file(path);
+    const std::string_view contents = file.GetContents();
+    const std::vector<std::string_view> chunks = SplitIntoChunks(contents, std::max<size_t>(options.chunk_bytes, 1));
+
+    size_t thread_count = options.parser_threads;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, chunks.size());
+
+    CorpusLoadProgress progress;
+    progress.bytes_total = contents.size();
+    ChunkPipeline pipeline(search_server, chunks, options, thread_count);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const ParsedChunk chunk = pipeline.Take(i);
+        for (const ParsedDocument& document : chunk.documents) {
+            try {
+                search_server.AddTokenizedDocument(document.record.id, document.tokens, document.record.status, document.record.ratings);
+            }
+            catch (...) {
+                RethrowWithLine(std::current_exception(), contents, document.line);
+            }
+            ++progress.documents_loaded;
+        }
+        if (chunk.error) {
+            RethrowWithLine(chunk.error, contents, chunk.error_line);
+        }
+
+        // Indexed words were copied, nothing points into this part of the file anymore.
+        file.ReleasePages(chunks[i].data() - contents.data(), chunks[i].size());
+        progress.bytes_done = chunks[i].data() + chunks[i].size() - contents.data();
+        progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (options.on_progress) {
+            options.on_progress(progress);
+        }
+    }
+    progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return progress;
+}
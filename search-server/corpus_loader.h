@@ -0,0 +1,57 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One document per line.
+//   TSV:   <id> \t <status> \t <ratings separated by spaces> \t <text>
+//   JSONL: {"id": 1, "status": "ACTUAL", "ratings": [5, -2], "text": "white cat"}
+// Status is a DocumentStatus name or its number. Empty lines are skipped, unknown JSON keys ignored.
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+// text views the parsed line, or decoded_text when a JSON string had escapes.
+struct CorpusRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct CorpusLoadProgress {
+    size_t bytes_done = 0;
+    size_t bytes_total = 0;
+    size_t documents_loaded = 0;
+    double seconds = 0.0;
+};
+
+struct CorpusLoadOptions {
+    CorpusFormat format = CorpusFormat::TSV;
+    // Threads that parse and tokenize; the calling thread indexes. 0 picks the hardware concurrency.
+    size_t parser_threads = 0;
+    // The file is cut into chunks of about this size at line boundaries.
+    size_t chunk_bytes = 4 << 20;
+    // Parsed chunks waiting for the indexer; bounds memory when indexing is the bottleneck.
+    size_t max_chunks_in_flight = 8;
+    // Called from the calling thread after every indexed chunk.
+    std::function<void(const CorpusLoadProgress&)> on_progress;
+};
+
+CorpusFormat ParseCorpusFormat(std::string_view name);
+
+// Parses one line without the trailing newline. Throws std::invalid_argument on malformed input.
+// decoded_text receives the document text only when it cannot be viewed in place.
+CorpusRecord ParseCorpusRecord(std::string_view line, CorpusFormat format, std::string& decoded_text);
+
+// Memory-maps the file and adds every record to the server. Record text is never copied: parser
+// threads tokenize straight from the mapping and only words new to the index are stored.
+// A malformed line or a rejected document stops the load with std::invalid_argument naming the line,
+// other failures keep their kind (std::out_of_range, otherwise std::runtime_error) and name it too;
+// documents from earlier lines stay indexed.
+CorpusLoadProgress LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options = {});
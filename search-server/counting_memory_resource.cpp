@@ -0,0 +1,30 @@
+#include "counting_memory_resource.h"
+
+CountingMemoryResource::CountingMemoryResource(std::pmr::memory_resource* upstream)
+    : upstream_(upstream) {
+}
+
+size_t CountingMemoryResource::GetBytes() const {
+    return bytes_.load(std::memory_order_relaxed);
+}
+
+size_t CountingMemoryResource::GetAllocationCount() const {
+    return allocation_count_.load(std::memory_order_relaxed);
+}
+
+void* CountingMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* const pointer = upstream_->allocate(bytes, alignment);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    allocation_count_.fetch_add(1, std::memory_order_relaxed);
+    return pointer;
+}
+
+void CountingMemoryResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream_->deallocate(pointer, bytes, alignment);
+    bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    allocation_count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool CountingMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
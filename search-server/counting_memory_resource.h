@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// Passes allocations through to an upstream resource and counts what is currently held.
+// Containers use it through std::pmr::polymorphic_allocator, which also hands it down to
+// nested containers and strings, so one counter covers a whole structure.
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    size_t GetBytes() const;
+
+    size_t GetAllocationCount() const;
+
+private:
+    std::pmr::memory_resource* const upstream_;
+    // Parallel RemoveDocument frees nodes from several threads at once.
+    std::atomic<size_t> bytes_ = 0;
+    std::atomic<size_t> allocation_count_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
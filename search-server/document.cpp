@@ -1,5 +1,7 @@
 #include "document.h"
 
+#include <cstdio>
+
 Document::Document(int id, double relevance, int rating)
     : id(id)
     , relevance(relevance)
@@ -12,4 +14,10 @@ std::ostream& operator<<(std::ostream& out, const Document& document) {
         << "relevance = " << document.relevance << ", "
         << "rating = " << document.rating << " }";
     return out;
+}
+
+std::string FormatRelevance(double relevance) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", relevance);
+    return buffer;
 }
\ No newline at end of file
@@ -13,4 +13,7 @@ struct Document {
     int rating = 0;
 };
 
-std::ostream& operator<<(std::ostream& out, const Document& document);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& out, const Document& document);
+
+// 17 significant digits parse back to exactly the same double, so rankings survive wire protocols.
+std::string FormatRelevance(double relevance);
\ No newline at end of file
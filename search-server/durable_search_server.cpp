@@ -0,0 +1,185 @@
+#include "durable_search_server.h"
+#include "binary_io.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const std::uint32_t CHECKPOINT_MAGIC = 0x5353434B;  // "SSCK"
+
+enum class RecordType : std::uint8_t {
+    ADD = 1,
+    REMOVE = 2,
+};
+
+std::string GetSnapshotPath(const std::string& directory) {
+    return directory + "/snapshot";
+}
+
+std::string GetLogPath(const std::string& directory) {
+    return directory + "/wal.log";
+}
+
+}  // namespace
+
+DurableSearchServer::DurableSearchServer(const std::string& directory, const std::string& stop_words_text,
+                                         const DurableSearchServerOptions& options)
+    : directory_(directory)
+    , options_(options)
+    , search_server_(OpenSnapshot(directory, stop_words_text, options.server, checkpoint_lsn_))
+    , log_(GetLogPath(directory), checkpoint_lsn_, [this](std::uint64_t, std::string_view payload) { ApplyRecord(payload); }, options.log)
+{
+}
+
+void DurableSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::string payload;
+    payload.reserve(document.size() + sizeof(int) * (ratings.size() + 4));
+    AppendBinary(payload, RecordType::ADD);
+    AppendBinary(payload, static_cast<std::int32_t>(document_id));
+    AppendBinary(payload, static_cast<std::int32_t>(status));
+    AppendBinary(payload, static_cast<std::uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        AppendBinary(payload, static_cast<std::int32_t>(rating));
+    }
+    AppendBinaryString(payload, document);
+
+    std::unique_lock lock(mutex_);
+    search_server_.AddDocument(document_id, document, status, ratings);
+    std::uint64_t lsn = 0;
+    try {
+        lsn = log_.Append(payload);
+        CommitRecord(lsn, lock);
+    }
+    catch (...) {
+        // The index must not keep a document the log may have lost.
+        if (!lock.owns_lock()) {
+            lock.lock();
+        }
+        if (lsn == 0 || log_.Discard(lsn)) {
+            search_server_.RemoveDocument(document_id);
+        }
+        throw;
+    }
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    std::string payload;
+    AppendBinary(payload, RecordType::REMOVE);
+    AppendBinary(payload, static_cast<std::int32_t>(document_id));
+
+    std::unique_lock lock(mutex_);
+    // Removing an unknown id changes nothing and is not logged.
+    if (!search_server_.HasDocument(document_id)) {
+        return;
+    }
+    const std::uint64_t lsn = log_.Append(payload);
+    if (options_.log.sync_on_commit) {
+        try {
+            log_.WaitDurable(lsn);
+        }
+        catch (...) {
+            log_.Discard(lsn);
+            throw;
+        }
+    }
+    search_server_.RemoveDocument(document_id);
+    CommitRecord(lsn, lock);
+}
+
+void DurableSearchServer::Sync() {
+    log_.Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+    std::lock_guard guard(mutex_);
+    log_.Sync();
+    const std::uint64_t lsn = log_.GetLastLsn();
+    WriteSnapshot(directory_, search_server_, lsn);
+    // A crash before the truncation is harmless: replay skips records the snapshot already holds.
+    log_.Truncate();
+    checkpoint_lsn_ = lsn;
+}
+
+const SearchServer& DurableSearchServer::GetSearchServer() const {
+    return search_server_;
+}
+
+size_t DurableSearchServer::GetLogSize() const {
+    return log_.GetSize();
+}
+
+SearchServer DurableSearchServer::OpenSnapshot(const std::string& directory, const std::string& stop_words_text,
+                                               const SearchServerOptions& options, std::uint64_t& checkpoint_lsn) {
+    std::filesystem::create_directories(directory);
+    const std::string path = GetSnapshotPath(directory);
+    if (!std::filesystem::exists(path)) {
+        // The first snapshot pins the stop words and options that the log will be replayed with.
+        SearchServer search_server(stop_words_text, options);
+        WriteSnapshot(directory, search_server, 0);
+        checkpoint_lsn = 0;
+        return search_server;
+    }
+    // A snapshot that exists but cannot be read must never be replaced by an empty one.
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    if (ReadBinary<std::uint32_t>(in) != CHECKPOINT_MAGIC) {
+        throw std::runtime_error("Not a checkpoint: " + path);
+    }
+    checkpoint_lsn = ReadBinary<std::uint64_t>(in);
+    return SearchServer::ReadSnapshot(in, options);
+}
+
+void DurableSearchServer::WriteSnapshot(const std::string& directory, const SearchServer& search_server, std::uint64_t lsn) {
+    const std::string path = GetSnapshotPath(directory);
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+        WriteBinary(out, CHECKPOINT_MAGIC);
+        WriteBinary(out, lsn);
+        search_server.WriteSnapshot(out);
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write " + temporary_path);
+        }
+    }
+    // The rename only replaces the old snapshot once the new one is complete on disk.
+    SyncPath(temporary_path);
+    std::filesystem::rename(temporary_path, path);
+    SyncPath(directory);
+}
+
+void DurableSearchServer::ApplyRecord(std::string_view payload) {
+    BinaryReader reader(payload);
+    const auto type = reader.Read<RecordType>();
+    const int document_id = reader.Read<std::int32_t>();
+    if (type == RecordType::REMOVE) {
+        search_server_.RemoveDocument(document_id);
+        return;
+    }
+    if (type != RecordType::ADD) {
+        throw std::runtime_error("Unknown write-ahead log record");
+    }
+    const auto status = static_cast<DocumentStatus>(reader.Read<std::int32_t>());
+    std::vector<int> ratings(reader.Read<std::uint32_t>());
+    for (int& rating : ratings) {
+        rating = reader.Read<std::int32_t>();
+    }
+    search_server_.AddDocument(document_id, reader.ReadString(), status, ratings);
+}
+
+void DurableSearchServer::CommitRecord(std::uint64_t lsn, std::unique_lock<std::mutex>& lock) {
+    if (options_.checkpoint_log_bytes > 0 && log_.GetSize() >= options_.checkpoint_log_bytes) {
+        lock.unlock();
+        Checkpoint();
+        return;
+    }
+    lock.unlock();
+    // Waiting outside the lock lets other writers append to the same group commit.
+    if (options_.log.sync_on_commit) {
+        log_.WaitDurable(lsn);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct DurableSearchServerOptions {
+    SearchServerOptions server;
+    WriteAheadLogOptions log;
+    // A checkpoint is taken automatically once the log outgrows this many bytes; 0 turns it off.
+    size_t checkpoint_log_bytes = 64 << 20;
+};
+
+// SearchServer whose mutations survive a restart. AddDocument and RemoveDocument are recorded in a
+// write-ahead log, Checkpoint writes a snapshot of the index and empties the log. Opening a directory
+// loads its snapshot and replays the log on top of it.
+class DurableSearchServer {
+public:
+    // Creates the directory when needed. An existing one keeps the stop words and positional_index
+    // it was created with; the other server options are taken from the arguments on every open,
+    // see SearchServer::ReadSnapshot, and the stemmer must not change.
+    DurableSearchServer(const std::string& directory, const std::string& stop_words_text,
+                        const DurableSearchServerOptions& options = {});
+
+    // The document is indexed first, so a rejected document is never logged, and removed again if
+    // the log cannot be written. May be called from several threads: with sync_on_commit their log
+    // syncs are shared.
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // A removed document cannot be put back, so with sync_on_commit the removal is durable before
+    // it is applied and holds off other writers meanwhile. Unknown ids are ignored without logging.
+    void RemoveDocument(int document_id);
+
+    // Makes every completed mutation durable, also when sync_on_commit is off.
+    void Sync();
+
+    void Checkpoint();
+
+    // Queries must not run concurrently with mutations, as with SearchServer itself.
+    const SearchServer& GetSearchServer() const;
+
+    size_t GetLogSize() const;
+
+private:
+    const std::string directory_;
+    const DurableSearchServerOptions options_;
+    std::mutex mutex_;
+    std::uint64_t checkpoint_lsn_ = 0;
+    SearchServer search_server_;
+    WriteAheadLog log_;
+
+    static SearchServer OpenSnapshot(const std::string& directory, const std::string& stop_words_text,
+                                     const SearchServerOptions& options, std::uint64_t& checkpoint_lsn);
+
+    static void WriteSnapshot(const std::string& directory, const SearchServer& search_server, std::uint64_t lsn);
+
+    void ApplyRecord(std::string_view payload);
+
+    // Checkpoints when the log is due and waits until the record is durable, with the lock released.
+    void CommitRecord(std::uint64_t lsn, std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,180 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct AtomicHistogram {
+    std::array<std::atomic<std::uint64_t>, HISTOGRAM_BUCKET_COUNT> buckets = {};
+    std::atomic<std::uint64_t> count = 0;
+    std::atomic<std::uint64_t> sum_ns = 0;
+
+    // Only the owning thread writes, so a relaxed load/store pair is enough and avoids locked instructions.
+    static void Increase(std::atomic<std::uint64_t>& value, std::uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    void Record(std::uint64_t duration_ns) {
+        size_t bucket = 0;
+        while (bucket + 1 < HISTOGRAM_BUCKET_COUNT && (duration_ns >> bucket) != 0) {
+            ++bucket;
+        }
+        Increase(buckets[bucket], 1);
+        Increase(count, 1);
+        Increase(sum_ns, duration_ns);
+    }
+
+    void AddTo(HistogramSnapshot& snapshot) const {
+        for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+            snapshot.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count += count.load(std::memory_order_relaxed);
+        snapshot.sum_ns += sum_ns.load(std::memory_order_relaxed);
+    }
+};
+
+struct ThreadStatistics {
+    std::array<AtomicHistogram, QUERY_PHASE_COUNT> phases;
+    AtomicHistogram total;
+    std::atomic<std::uint64_t> postings_visited = 0;
+    std::atomic<std::uint64_t> documents_scored = 0;
+
+    void AddTo(InstrumentationSnapshot& snapshot) const {
+        for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+            phases[i].AddTo(snapshot.phases[i]);
+        }
+        total.AddTo(snapshot.total);
+        snapshot.postings_visited += postings_visited.load(std::memory_order_relaxed);
+        snapshot.documents_scored += documents_scored.load(std::memory_order_relaxed);
+    }
+};
+
+void Subtract(HistogramSnapshot& histogram, const HistogramSnapshot& other) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        histogram.buckets[i] -= other.buckets[i];
+    }
+    histogram.count -= other.count;
+    histogram.sum_ns -= other.sum_ns;
+}
+
+void Subtract(InstrumentationSnapshot& snapshot, const InstrumentationSnapshot& other) {
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        Subtract(snapshot.phases[i], other.phases[i]);
+    }
+    Subtract(snapshot.total, other.total);
+    snapshot.postings_visited -= other.postings_visited;
+    snapshot.documents_scored -= other.documents_scored;
+}
+
+struct StatisticsRegistry {
+    std::mutex mutex;
+    // Statistics of running threads.
+    std::vector<const ThreadStatistics*> threads;
+    // Totals of finished threads, folded in when they exit.
+    InstrumentationSnapshot retired;
+    // Totals at the last reset; counters only grow, so later totals never fall below it.
+    InstrumentationSnapshot baseline;
+
+    // Callers hold the mutex.
+    InstrumentationSnapshot CollectTotals() const {
+        InstrumentationSnapshot snapshot = retired;
+        for (const ThreadStatistics* statistics : threads) {
+            statistics->AddTo(snapshot);
+        }
+        return snapshot;
+    }
+};
+
+StatisticsRegistry& GetRegistry() {
+    static StatisticsRegistry registry;
+    return registry;
+}
+
+// Registers the thread's statistics on first use and retires them when the thread exits.
+class ThreadStatisticsOwner {
+public:
+    ThreadStatisticsOwner() {
+        auto& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.threads.push_back(&statistics_);
+    }
+
+    ~ThreadStatisticsOwner() {
+        auto& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        statistics_.AddTo(registry.retired);
+        registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &statistics_));
+    }
+
+    ThreadStatisticsOwner(const ThreadStatisticsOwner&) = delete;
+    ThreadStatisticsOwner& operator=(const ThreadStatisticsOwner&) = delete;
+
+    ThreadStatistics& Get() {
+        return statistics_;
+    }
+
+private:
+    ThreadStatistics statistics_;
+};
+
+ThreadStatistics& GetThreadStatistics() {
+    // Thread-local objects are destroyed before statics, so the registry outlives every owner.
+    thread_local ThreadStatisticsOwner owner;
+    return owner.Get();
+}
+
+}  // namespace
+
+std::uint64_t QueryTrace::GetPhaseNanoseconds(QueryPhase phase) const {
+    return phase_ns[static_cast<size_t>(phase)];
+}
+
+std::uint64_t QueryTrace::GetTotalNanoseconds() const {
+    std::uint64_t total = 0;
+    for (const auto duration : phase_ns) {
+        total += duration;
+    }
+    return total;
+}
+
+std::uint64_t HistogramSnapshot::GetPercentile(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<std::uint64_t>(percentile / 100.0 * (count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return i == 0 ? 0 : (std::uint64_t(1) << i) - 1;
+        }
+    }
+    return ~std::uint64_t(0);
+}
+
+void RecordQueryTrace(const QueryTrace& trace) {
+    auto& statistics = GetThreadStatistics();
+    for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+        statistics.phases[i].Record(trace.phase_ns[i]);
+    }
+    statistics.total.Record(trace.GetTotalNanoseconds());
+    AtomicHistogram::Increase(statistics.postings_visited, trace.postings_visited);
+    AtomicHistogram::Increase(statistics.documents_scored, trace.documents_scored);
+}
+
+InstrumentationSnapshot AggregateQueryStatistics() {
+    auto& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    InstrumentationSnapshot snapshot = registry.CollectTotals();
+    Subtract(snapshot, registry.baseline);
+    return snapshot;
+}
+
+void ResetQueryStatistics() {
+    auto& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    registry.baseline = registry.CollectTotals();
+}
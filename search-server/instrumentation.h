@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Instrumentation is compiled in only when SEARCH_SERVER_INSTRUMENTATION is defined.
+// Otherwise the TRACE_* macros expand to nothing and the query paths carry no timers or counters.
+
+#define INSTRUMENTATION_CONCAT_INTERNAL(X, Y) X##Y
+#define INSTRUMENTATION_CONCAT(X, Y) INSTRUMENTATION_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+#define TRACE_PHASE(trace, phase) PhaseTimer INSTRUMENTATION_CONCAT(phaseTimer, __LINE__)(trace, phase)
+#define TRACE_COUNT(trace, counter, value) do { if (trace) { (trace)->counter += (value); } } while (false)
+#define TRACE_RECORD(trace) RecordQueryTrace(trace)
+#else
+#define TRACE_PHASE(trace, phase)
+#define TRACE_COUNT(trace, counter, value)
+#define TRACE_RECORD(trace)
+#endif
+
+enum class QueryPhase {
+    PARSE,
+    PLAN,
+    POSTING_SCAN,
+    MINUS_FILTER,
+    SORT_TOP_K,
+};
+
+const size_t QUERY_PHASE_COUNT = 5;
+const size_t HISTOGRAM_BUCKET_COUNT = 64;
+
+struct QueryTrace {
+    std::array<std::uint64_t, QUERY_PHASE_COUNT> phase_ns = {};
+    std::uint64_t postings_visited = 0;
+    std::uint64_t documents_scored = 0;
+
+    std::uint64_t GetPhaseNanoseconds(QueryPhase phase) const;
+
+    std::uint64_t GetTotalNanoseconds() const;
+};
+
+// Bucket i holds durations in [2^(i-1), 2^i) nanoseconds, bucket 0 holds zero-length durations.
+struct HistogramSnapshot {
+    std::array<std::uint64_t, HISTOGRAM_BUCKET_COUNT> buckets = {};
+    std::uint64_t count = 0;
+    std::uint64_t sum_ns = 0;
+
+    // Upper bound of the bucket containing the given percentile (0..100), in nanoseconds.
+    std::uint64_t GetPercentile(double percentile) const;
+};
+
+struct InstrumentationSnapshot {
+    std::array<HistogramSnapshot, QUERY_PHASE_COUNT> phases;
+    HistogramSnapshot total;
+    std::uint64_t postings_visited = 0;
+    std::uint64_t documents_scored = 0;
+};
+
+// Adds the trace to the calling thread's histograms. Writers never contend with each other:
+// every thread owns its histograms, and only aggregation takes the registry lock.
+void RecordQueryTrace(const QueryTrace& trace);
+
+InstrumentationSnapshot AggregateQueryStatistics();
+
+// Following aggregations count only the queries recorded after the reset. Owners' counters are not
+// touched: the reset remembers the current totals and later aggregations subtract them.
+void ResetQueryStatistics();
+
+class PhaseTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PhaseTimer(QueryTrace* trace, QueryPhase phase)
+        : trace_(trace)
+        , phase_(phase) {
+    }
+
+    ~PhaseTimer() {
+        if (trace_) {
+            const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_);
+            trace_->phase_ns[static_cast<size_t>(phase_)] += duration.count();
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    QueryTrace* trace_;
+    const QueryPhase phase_;
+    const Clock::time_point start_time_ = Clock::now();
+};
@@ -0,0 +1,181 @@
+#include "benchmark_report.h"
+#include "corpus_generator.h"
+#include "socket_io.h"
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct LoadOptions {
+    string host = "127.0.0.1";
+    int port = 7700;
+    size_t connections = 4;
+    size_t depth = 16;
+    size_t requests = 100000;
+    CorpusOptions corpus;
+    string output_path;
+};
+
+void PrintUsage() {
+    cerr << "Usage: search_load_generator [--host=IP] [--port=N] [--connections=N] [--depth=N] [--requests=N]\n"
+            "       [--queries=N] [--words-per-query=N] [--vocabulary=N] [--zipf=S] [--seed=N] [--output=FILE]\n";
+}
+
+LoadOptions ParseOptions(int argc, char** argv) {
+    LoadOptions options;
+    options.corpus.document_count = 0;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const auto equals = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || equals == string::npos) {
+            PrintUsage();
+            exit(2);
+        }
+        const string name = argument.substr(2, equals - 2);
+        const string value = argument.substr(equals + 1);
+        if (name == "host") {
+            options.host = value;
+        }
+        else if (name == "port") {
+            options.port = stoi(value);
+        }
+        else if (name == "connections") {
+            options.connections = stoul(value);
+        }
+        else if (name == "depth") {
+            options.depth = stoul(value);
+        }
+        else if (name == "requests") {
+            options.requests = stoul(value);
+        }
+        else if (name == "queries") {
+            options.corpus.query_count = stoul(value);
+        }
+        else if (name == "words-per-query") {
+            options.corpus.words_per_query = stoul(value);
+        }
+        else if (name == "vocabulary") {
+            options.corpus.vocabulary_size = stoul(value);
+        }
+        else if (name == "zipf") {
+            options.corpus.zipf_exponent = stod(value);
+        }
+        else if (name == "seed") {
+            options.corpus.seed = stoull(value);
+        }
+        else if (name == "output") {
+            options.output_path = value;
+        }
+        else {
+            PrintUsage();
+            exit(2);
+        }
+    }
+    if (options.connections == 0 || options.depth == 0) {
+        PrintUsage();
+        exit(2);
+    }
+    return options;
+}
+
+struct ConnectionResult {
+    vector<uint64_t> latencies;
+    size_t errors = 0;
+};
+
+// Keeps up to depth requests in flight on one connection; answers come back in request order.
+ConnectionResult RunConnection(const LoadOptions& options, const vector<string>& queries, size_t first_request, size_t request_count) {
+    ConnectionResult result;
+    result.latencies.reserve(request_count);
+    LineConnection connection(ConnectTcpSocket(options.host, options.port));
+
+    deque<BenchmarkClock::time_point> send_times;
+    size_t sent = 0;
+    string batch;
+    string answer;
+    while (result.latencies.size() < request_count) {
+        batch.clear();
+        while (sent < request_count && send_times.size() < options.depth) {
+            batch += "FIND\t" + queries[(first_request + sent) % queries.size()] + '\n';
+            send_times.push_back(BenchmarkClock::now());
+            ++sent;
+        }
+        if (!batch.empty()) {
+            connection.WriteAll(batch);
+        }
+        if (!connection.ReadLine(answer)) {
+            throw runtime_error("Server closed the connection");
+        }
+        result.latencies.push_back(ElapsedNanoseconds(send_times.front()));
+        send_times.pop_front();
+        if (answer.rfind("OK", 0) != 0) {
+            ++result.errors;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const LoadOptions options = ParseOptions(argc, argv);
+    const vector<string> queries = GenerateCorpus(options.corpus).queries;
+    if (queries.empty()) {
+        cerr << "No queries to send"s << endl;
+        return 2;
+    }
+
+    vector<ConnectionResult> results(options.connections);
+    vector<thread> threads;
+    const auto start = BenchmarkClock::now();
+    for (size_t i = 0; i < options.connections; ++i) {
+        const size_t first_request = options.requests * i / options.connections;
+        const size_t request_count = options.requests * (i + 1) / options.connections - first_request;
+        threads.emplace_back([&options, &queries, &results, i, first_request, request_count] {
+            try {
+                results[i] = RunConnection(options, queries, first_request, request_count);
+            }
+            catch (const exception& e) {
+                cerr << "Connection "s << i << " failed: "s << e.what() << endl;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = ElapsedNanoseconds(start) / 1e9;
+
+    vector<uint64_t> latencies;
+    size_t errors = 0;
+    for (auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        errors += result.errors;
+    }
+
+    JsonReport report;
+    report.AddNumber("config", "connections", options.connections);
+    report.AddNumber("config", "depth", options.depth);
+    report.AddNumber("config", "requests", options.requests);
+    report.AddNumber("throughput", "seconds", seconds);
+    report.AddNumber("throughput", "queries_per_second", latencies.size() / seconds);
+    report.AddNumber("throughput", "errors", errors);
+    report.AddLatency("latency", Summarize(move(latencies)));
+
+    if (options.output_path.empty()) {
+        report.Print(cout);
+    }
+    else {
+        ofstream out(options.output_path);
+        report.Print(out);
+    }
+    return 0;
+}
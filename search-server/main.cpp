@@ -1,5 +1,6 @@
 ﻿#include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 
 #include <execution>
 #include <iostream>
@@ -16,6 +17,9 @@ void PrintDocument(const Document& document) {
 }
 
 int main() {
+    TestSearchServer();
+    cout << "Search server checks passed"s << endl;
+
     SearchServer search_server("and with"s);
 
     int id = 0;
@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        throw std::runtime_error("open " + path + ": " + std::strerror(errno));
+    }
+    struct stat file_status {};
+    if (fstat(descriptor, &file_status) < 0) {
+        const int error = errno;
+        close(descriptor);
+        throw std::runtime_error("stat " + path + ": " + std::strerror(error));
+    }
+    size_ = static_cast<size_t>(file_status.st_size);
+    // mmap rejects empty ranges, an empty file simply has empty contents.
+    if (size_ > 0) {
+        void* const data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(descriptor);
+            throw std::runtime_error("mmap " + path + ": " + std::strerror(error));
+        }
+        data_ = static_cast<const char*>(data);
+        // Parsers walk the file front to back, so aggressive read-ahead pays off.
+        madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+    }
+    close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::string_view MappedFile::GetContents() const {
+    return { data_, size_ };
+}
+
+void MappedFile::ReleasePages(size_t offset, size_t size) const {
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = (offset + page_size - 1) / page_size * page_size;
+    const size_t end = std::min(offset + size, size_) / page_size * page_size;
+    if (data_ != nullptr && begin < end) {
+        madvise(const_cast<char*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. Views into GetContents stay valid while the object lives.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view GetContents() const;
+
+    // Lets the kernel drop pages that were already read; the mapping stays usable.
+    void ReleasePages(size_t offset, size_t size) const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
 
 template <typename Iterator>
 class IteratorRange {
@@ -27,33 +30,94 @@ private:
     Iterator end_;
 };
 
+// Pages are not stored: every page boundary is computed when the page is requested,
+// which is O(1) for random-access iterators.
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator() = default;
-    Paginator(Iterator begin, Iterator end, size_t size) {
-        if (size == 0 || distance(begin, end) == 0)
-            throw std::invalid_argument("Can't create object with such parameters");
-        while (distance(begin, end) > (int)size) {
-            pages_.push_back(IteratorRange(begin, begin + size));
-            advance(begin, size);
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator(Iterator page_begin, size_t remaining, size_t page_size)
+            : page_begin_(page_begin)
+            , remaining_(remaining)
+            , page_size_(page_size)
+        {}
+
+        IteratorRange<Iterator> operator*() const {
+            return IteratorRange(page_begin_, std::next(page_begin_, GetCurrentPageSize()));
         }
-        if (distance(begin, end) != 0) {
-            pages_.push_back(IteratorRange(begin, end));
+
+        PageIterator& operator++() {
+            const size_t current_page_size = GetCurrentPageSize();
+            std::advance(page_begin_, current_page_size);
+            remaining_ -= current_page_size;
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return remaining_ == other.remaining_;
+        }
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator page_begin_;
+        size_t remaining_;
+        size_t page_size_;
+
+        size_t GetCurrentPageSize() const {
+            return std::min(page_size_, remaining_);
         }
+    };
+
+    Paginator() = default;
+    Paginator(Iterator begin, Iterator end, size_t size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(size)
+        , item_count_(distance(begin, end))
+    {
+        if (size == 0 || item_count_ == 0)
+            throw std::invalid_argument("Can't create object with such parameters");
     }
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return PageIterator(begin_, item_count_, page_size_);
     }
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return PageIterator(end_, 0, page_size_);
     }
-    size_t size() {
-        return pages_.size();
+    size_t size() const {
+        return (item_count_ + page_size_ - 1) / page_size_;
     }
+
+    IteratorRange<Iterator> GetPage(size_t index) const {
+        if (index >= size()) {
+            throw std::out_of_range("Page index is out of range");
+        }
+        const size_t offset = index * page_size_;
+        const Iterator page_begin = std::next(begin_, offset);
+        return IteratorRange(page_begin, std::next(page_begin, std::min(page_size_, item_count_ - offset)));
+    }
+
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_ = 0;
+    size_t item_count_ = 0;
 };
 
 template <typename Iterator>
@@ -67,4 +131,4 @@ std::ostream& operator<<(std::ostream& os, const IteratorRange<Iterator>& range)
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+#include "positional_index.h"
+
+#include <algorithm>
+#include <utility>
+
+PositionList::PositionList(const allocator_type& allocator)
+    : bytes_(allocator) {
+}
+
+PositionList::PositionList(const PositionList& other, const allocator_type& allocator)
+    : bytes_(other.bytes_, allocator)
+    , last_position_(other.last_position_)
+    , count_(other.count_) {
+}
+
+PositionList::PositionList(PositionList&& other, const allocator_type& allocator)
+    : bytes_(std::move(other.bytes_), allocator)
+    , last_position_(other.last_position_)
+    , count_(other.count_) {
+}
+
+void PositionList::Append(std::uint32_t position) {
+    std::uint32_t delta = count_ == 0 ? position : position - last_position_;
+    while (delta >= 0x80) {
+        bytes_.push_back(static_cast<std::uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    bytes_.push_back(static_cast<std::uint8_t>(delta));
+    last_position_ = position;
+    ++count_;
+}
+
+void PositionList::DecodeTo(std::pmr::vector<std::uint32_t>& positions) const {
+    positions.clear();
+    positions.reserve(count_);
+    std::uint32_t position = 0;
+    std::uint32_t delta = 0;
+    int shift = 0;
+    for (const std::uint8_t byte : bytes_) {
+        delta |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += delta;
+        positions.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+}
+
+size_t PositionList::GetCount() const {
+    return count_;
+}
+
+bool ContainsPhrase(const std::pmr::vector<const PositionList*>& term_positions, int slop) {
+    if (term_positions.empty()) {
+        return true;
+    }
+    if (std::any_of(term_positions.begin(), term_positions.end(), [](const PositionList* list) { return list == nullptr; })) {
+        return false;
+    }
+
+    std::pmr::vector<std::pmr::vector<std::uint32_t>> positions(term_positions.size(), term_positions.get_allocator());
+    for (size_t i = 0; i < term_positions.size(); ++i) {
+        term_positions[i]->DecodeTo(positions[i]);
+    }
+
+    // Occurrences of the i-th term that end some match of the first i + 1 terms. Taking only the
+    // nearest following occurrence is not enough with slop: a later one may reach the next term.
+    const std::uint32_t max_gap = static_cast<std::uint32_t>(slop) + 1;
+    std::pmr::vector<std::uint32_t> reachable = std::move(positions[0]);
+    std::pmr::vector<std::uint32_t> next_reachable(term_positions.get_allocator());
+    for (size_t i = 1; i < positions.size(); ++i) {
+        next_reachable.clear();
+        auto previous = reachable.begin();
+        for (const std::uint32_t position : positions[i]) {
+            // The first reachable occurrence close enough to precede this one.
+            while (previous != reachable.end() && *previous + max_gap < position) {
+                ++previous;
+            }
+            if (previous != reachable.end() && *previous < position) {
+                next_reachable.push_back(position);
+            }
+        }
+        if (next_reachable.empty()) {
+            return false;
+        }
+        reachable.swap(next_reachable);
+    }
+    return !reachable.empty();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Ascending word positions of one term in one document, stored as varint-encoded deltas.
+// Typical documents need one byte per position instead of four.
+class PositionList {
+public:
+    // Lets pmr containers place the encoded bytes in their own memory resource.
+    using allocator_type = std::pmr::polymorphic_allocator<std::uint8_t>;
+
+    PositionList() = default;
+
+    explicit PositionList(const allocator_type& allocator);
+
+    PositionList(const PositionList& other, const allocator_type& allocator);
+
+    PositionList(PositionList&& other, const allocator_type& allocator);
+
+    // Positions must be appended in strictly ascending order.
+    void Append(std::uint32_t position);
+
+    void DecodeTo(std::pmr::vector<std::uint32_t>& positions) const;
+
+    size_t GetCount() const;
+
+private:
+    std::pmr::vector<std::uint8_t> bytes_;
+    std::uint32_t last_position_ = 0;
+    std::uint32_t count_ = 0;
+};
+
+// Checks whether the terms occur in the given order with at most slop extra words
+// between neighbours. slop == 0 means an exact phrase. Decoded positions are allocated
+// with the allocator of term_positions.
+bool ContainsPhrase(const std::pmr::vector<const PositionList*>& term_positions, int slop);
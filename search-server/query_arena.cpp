@@ -0,0 +1,90 @@
+#include "query_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+thread_local ArenaMemoryResource thread_arena;
+thread_local int thread_arena_depth = 0;
+
+}  // namespace
+
+ArenaMemoryResource::ArenaMemoryResource(size_t initial_block_size, std::pmr::memory_resource* upstream)
+    : upstream_(upstream)
+    , initial_block_size_(std::max<size_t>(initial_block_size, 64)) {
+}
+
+ArenaMemoryResource::~ArenaMemoryResource() {
+    for (const Block& block : blocks_) {
+        upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+    }
+}
+
+void ArenaMemoryResource::Reset(size_t max_retained_bytes) {
+    size_t retained = 0;
+    size_t kept = 0;
+    while (kept < blocks_.size() && retained + blocks_[kept].size <= max_retained_bytes) {
+        retained += blocks_[kept++].size;
+    }
+    for (size_t i = kept; i < blocks_.size(); ++i) {
+        upstream_->deallocate(blocks_[i].data, blocks_[i].size, alignof(std::max_align_t));
+    }
+    blocks_.resize(kept);
+    current_block_ = 0;
+    offset_ = 0;
+}
+
+size_t ArenaMemoryResource::GetCapacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks_) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+void* ArenaMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        if (current_block_ < blocks_.size()) {
+            const Block& block = blocks_[current_block_];
+            const auto address = reinterpret_cast<std::uintptr_t>(block.data) + offset_;
+            const size_t padding = (alignment - address % alignment) % alignment;
+            if (offset_ + padding + bytes <= block.size) {
+                void* const pointer = block.data + offset_ + padding;
+                offset_ += padding + bytes;
+                return pointer;
+            }
+            ++current_block_;
+            offset_ = 0;
+            continue;
+        }
+
+        // Blocks double so that a growing query needs few of them.
+        const size_t previous_size = blocks_.empty() ? initial_block_size_ / 2 : blocks_.back().size;
+        const size_t size = std::max(previous_size * 2, bytes + alignment);
+        blocks_.push_back({ static_cast<std::byte*>(upstream_->allocate(size, alignof(std::max_align_t))), size });
+        current_block_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+void ArenaMemoryResource::do_deallocate(void*, size_t, size_t) {
+}
+
+bool ArenaMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+QueryArenaScope::QueryArenaScope() {
+    ++thread_arena_depth;
+}
+
+QueryArenaScope::~QueryArenaScope() {
+    if (--thread_arena_depth == 0) {
+        thread_arena.Reset();
+    }
+}
+
+std::pmr::memory_resource* QueryArenaScope::GetResource() const {
+    return &thread_arena;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for memory that dies with a query. Deallocation is a no-op; Reset rewinds to
+// the first block and keeps the blocks, so once a thread has seen its largest query it serves
+// the following ones without touching the global heap.
+class ArenaMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit ArenaMemoryResource(size_t initial_block_size = 64 << 10,
+                                 std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    ~ArenaMemoryResource() override;
+
+    ArenaMemoryResource(const ArenaMemoryResource&) = delete;
+    ArenaMemoryResource& operator=(const ArenaMemoryResource&) = delete;
+
+    // Blocks beyond max_retained_bytes are returned upstream, so one huge query does not pin its
+    // memory to the thread forever.
+    void Reset(size_t max_retained_bytes = 16 << 20);
+
+    size_t GetCapacity() const;
+
+private:
+    struct Block {
+        std::byte* data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource* const upstream_;
+    const size_t initial_block_size_;
+    std::vector<Block> blocks_;
+    size_t current_block_ = 0;
+    size_t offset_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Gives access to the calling thread's arena. Scopes nest: the outermost one resets the arena when
+// it ends, so nothing allocated from it may outlive that scope. The arena is not shared between
+// threads, work handed to other threads must allocate elsewhere.
+class QueryArenaScope {
+public:
+    QueryArenaScope();
+
+    ~QueryArenaScope();
+
+    QueryArenaScope(const QueryArenaScope&) = delete;
+    QueryArenaScope& operator=(const QueryArenaScope&) = delete;
+
+    std::pmr::memory_resource* GetResource() const;
+};
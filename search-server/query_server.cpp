@@ -0,0 +1,421 @@
+#include "query_server.h"
+#include "socket_io.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+namespace {
+
+const std::uint64_t LISTEN_ID = 0;
+const std::uint64_t WAKE_ID = 1;
+
+int CreateEpoll() {
+    const int descriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (descriptor < 0) {
+        throw std::runtime_error("epoll_create1 failed");
+    }
+    return descriptor;
+}
+
+int CreateEventFd() {
+    const int descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (descriptor < 0) {
+        throw std::runtime_error("eventfd failed");
+    }
+    return descriptor;
+}
+
+void AddToEpoll(int epoll_descriptor, int descriptor, std::uint64_t id, std::uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_descriptor, EPOLL_CTL_ADD, descriptor, &event) < 0) {
+        throw std::runtime_error("epoll_ctl failed");
+    }
+}
+
+void Wake(int wake_descriptor) {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const auto written = write(wake_descriptor, &one, sizeof(one));
+}
+
+}  // namespace
+
+QueryServer::QueryServer(const SearchServer& search_server, const QueryServerOptions& options)
+    : search_server_(search_server)
+    , options_(options)
+    , listen_descriptor_(ListenTcpSocket(options.host, options.port))
+    , epoll_descriptor_(CreateEpoll())
+    , wake_descriptor_(CreateEventFd())
+{
+    if (options_.worker_count == 0 || options_.max_batch_size == 0) {
+        throw std::invalid_argument("Query server needs at least one worker and a non-empty batch");
+    }
+    SetNonBlocking(listen_descriptor_);
+    AddToEpoll(epoll_descriptor_, listen_descriptor_, LISTEN_ID, EPOLLIN);
+    AddToEpoll(epoll_descriptor_, wake_descriptor_, WAKE_ID, EPOLLIN);
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    for (auto& [_, connection] : connections_) {
+        close(connection.descriptor);
+    }
+    close(wake_descriptor_);
+    close(epoll_descriptor_);
+    close(listen_descriptor_);
+}
+
+int QueryServer::GetPort() const {
+    return GetLocalPort(listen_descriptor_);
+}
+
+void QueryServer::Run() {
+    for (size_t i = 0; i < options_.worker_count; ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+
+    std::vector<epoll_event> events(256);
+    while (!stopping_) {
+        const int event_count = epoll_wait(epoll_descriptor_, events.data(), static_cast<int>(events.size()), -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < event_count; ++i) {
+            const std::uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                AcceptConnections();
+                continue;
+            }
+            if (id == WAKE_ID) {
+                std::uint64_t counter = 0;
+                [[maybe_unused]] const auto received = read(wake_descriptor_, &counter, sizeof(counter));
+                DeliverCompletions();
+                continue;
+            }
+
+            auto it = connections_.find(id);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            // A hung-up socket cannot take the answers anymore.
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                CloseConnection(id);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                ReadRequests(id, connection);
+            }
+            if (events[i].events & EPOLLOUT) {
+                WriteResponses(connection);
+            }
+            UpdateEvents(id, connection);
+        }
+    }
+
+    {
+        std::lock_guard guard(tasks_mutex_);
+        stopping_ = true;
+    }
+    tasks_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void QueryServer::Stop() {
+    {
+        std::lock_guard guard(tasks_mutex_);
+        stopping_ = true;
+    }
+    tasks_ready_.notify_all();
+    Wake(wake_descriptor_);
+}
+
+void QueryServer::RunWorker() {
+    std::vector<Task> batch;
+    std::vector<Completion> results;
+    while (true) {
+        batch.clear();
+        {
+            std::unique_lock lock(tasks_mutex_);
+            tasks_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            while (!tasks_.empty() && batch.size() < options_.max_batch_size) {
+                batch.push_back(std::move(tasks_.front()));
+                tasks_.pop_front();
+            }
+        }
+
+        results.clear();
+        for (Task& task : batch) {
+            results.push_back({ task.connection_id, task.sequence, HandleRequest(task.request) });
+        }
+
+        {
+            std::lock_guard guard(completions_mutex_);
+            for (Completion& result : results) {
+                completions_.push_back(std::move(result));
+            }
+        }
+        Wake(wake_descriptor_);
+    }
+}
+
+void QueryServer::AcceptConnections() {
+    while (true) {
+        const int descriptor = accept(listen_descriptor_, nullptr, nullptr);
+        if (descriptor < 0) {
+            return;
+        }
+        SetNonBlocking(descriptor);
+        const int enable = 1;
+        setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        const std::uint64_t id = next_connection_id_++;
+        Connection& connection = connections_[id];
+        connection.descriptor = descriptor;
+        connection.events = EPOLLIN | EPOLLRDHUP;
+        AddToEpoll(epoll_descriptor_, descriptor, id, connection.events);
+    }
+}
+
+void QueryServer::ReadRequests(std::uint64_t connection_id, Connection& connection) {
+    char chunk[16384];
+    while (!connection.peer_closed) {
+        const ssize_t received = read(connection.descriptor, chunk, sizeof(chunk));
+        if (received > 0) {
+            connection.input.append(chunk, static_cast<size_t>(received));
+            // The socket is level-triggered, the rest is read once these lines are taken.
+            if (connection.input.size() > options_.max_request_length) {
+                break;
+            }
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        connection.peer_closed = true;
+    }
+
+    std::vector<Task> new_tasks;
+    size_t line_start = 0;
+    while (true) {
+        const auto line_end = connection.input.find('\n', line_start);
+        if (line_end == connection.input.npos) {
+            break;
+        }
+        new_tasks.push_back({ connection_id, connection.next_sequence++, connection.input.substr(line_start, line_end - line_start) });
+        line_start = line_end + 1;
+    }
+    connection.input.erase(0, line_start);
+    if (connection.input.size() > options_.max_request_length) {
+        // The line may never end; answer after the earlier requests and stop reading.
+        connection.input.clear();
+        connection.input.shrink_to_fit();
+        connection.peer_closed = true;
+        connection.ready_responses.emplace(connection.next_sequence++, AnswerRequest([]() -> std::string {
+            throw std::invalid_argument("Request line is too long");
+            }));
+        QueueReadyResponses(connection);
+    }
+    else if (connection.peer_closed && !connection.input.empty()) {
+        // The last request may end with the connection instead of a newline.
+        new_tasks.push_back({ connection_id, connection.next_sequence++, std::move(connection.input) });
+        connection.input.clear();
+    }
+
+    if (!new_tasks.empty()) {
+        {
+            std::lock_guard guard(tasks_mutex_);
+            for (Task& task : new_tasks) {
+                tasks_.push_back(std::move(task));
+            }
+        }
+        if (new_tasks.size() == 1) {
+            tasks_ready_.notify_one();
+        }
+        else {
+            tasks_ready_.notify_all();
+        }
+    }
+}
+
+void QueryServer::DeliverCompletions() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard guard(completions_mutex_);
+        completions.swap(completions_);
+    }
+
+    std::vector<std::uint64_t> touched;
+    for (Completion& completion : completions) {
+        auto it = connections_.find(completion.connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        it->second.ready_responses.emplace(completion.sequence, std::move(completion.response));
+        touched.push_back(completion.connection_id);
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (const std::uint64_t id : touched) {
+        Connection& connection = connections_.at(id);
+        QueueReadyResponses(connection);
+        WriteResponses(connection);
+        UpdateEvents(id, connection);
+    }
+}
+
+void QueryServer::QueueReadyResponses(Connection& connection) {
+    // Responses leave in request order even when workers finish out of order.
+    for (auto it = connection.ready_responses.begin();
+        it != connection.ready_responses.end() && it->first == connection.next_to_send;
+        it = connection.ready_responses.erase(it)) {
+        connection.output += it->second;
+        connection.output += '\n';
+        ++connection.next_to_send;
+    }
+}
+
+void QueryServer::WriteResponses(Connection& connection) {
+    while (!connection.output.empty()) {
+        const ssize_t sent = send(connection.descriptor, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.output.erase(0, static_cast<size_t>(sent));
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        // The peer is gone: drop what is left, the connection closes once nothing is pending.
+        connection.output.clear();
+        connection.peer_closed = true;
+    }
+}
+
+void QueryServer::UpdateEvents(std::uint64_t connection_id, Connection& connection) {
+    const std::uint64_t pending = connection.next_sequence - connection.next_to_send;
+    if (connection.peer_closed && pending == 0 && connection.output.empty()) {
+        CloseConnection(connection_id);
+        return;
+    }
+
+    std::uint32_t events = 0;
+    if (!connection.peer_closed && pending < options_.max_pending_per_connection) {
+        events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        epoll_ctl(epoll_descriptor_, EPOLL_CTL_MOD, connection.descriptor, &event);
+        connection.events = events;
+    }
+}
+
+void QueryServer::CloseConnection(std::uint64_t connection_id) {
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, it->second.descriptor, nullptr);
+    close(it->second.descriptor);
+    connections_.erase(it);
+}
+
+std::string QueryServer::HandleRequest(const std::string_view request) const {
+    return AnswerRequest([this, request] {
+        const auto fields = SplitIntoFields(request, '\t');
+        const std::string_view command = fields[0];
+        std::string answer = "OK";
+
+        if (command == "FIND" && (fields.size() == 2 || fields.size() == 3)) {
+            const auto status = fields.size() == 3
+                ? static_cast<DocumentStatus>(std::stoi(std::string(fields[1])))
+                : DocumentStatus::ACTUAL;
+            for (const Document& document : search_server_.FindTopDocuments(fields.back(), status)) {
+                answer += '\t' + std::to_string(document.id) + '\t' + FormatRelevance(document.relevance) + '\t' + std::to_string(document.rating);
+            }
+        }
+        else if (command == "MATCH" && fields.size() == 3) {
+            const auto [words, status] = search_server_.MatchDocument(fields[2], std::stoi(std::string(fields[1])));
+            answer += '\t' + std::to_string(static_cast<int>(status));
+            for (const std::string_view word : words) {
+                answer += '\t';
+                answer += word;
+            }
+        }
+        else if (command == "EXPLAIN" && fields.size() == 2) {
+            const QueryPlan plan = search_server_.ExplainQuery(fields[1]);
+            answer += '\t';
+            answer += GetQueryEvaluationName(plan.evaluation);
+            for (const auto& [sign, terms] : { std::pair{ '+', &plan.plus_terms }, std::pair{ '-', &plan.minus_terms } }) {
+                for (const PlannedTerm& term : *terms) {
+                    answer += '\t';
+                    answer += sign;
+                    answer += term.word + '\t' + std::to_string(term.posting_count);
+                }
+            }
+        }
+        else if (command == "STATS" && fields.size() == 1) {
+            const SearchServerStats stats = search_server_.GetStats(0);
+            const std::pair<const char*, size_t> values[] = {
+                { "documents", stats.document_count },
+                { "terms", stats.term_count },
+                { "postings", stats.posting_count },
+                { "total_bytes", stats.total_bytes },
+                { "words_bytes", stats.words.bytes },
+                { "word_to_document_freqs_bytes", stats.word_to_document_freqs.bytes },
+                { "document_to_word_freqs_bytes", stats.document_to_word_freqs.bytes },
+                { "documents_bytes", stats.documents.bytes },
+                { "document_ids_bytes", stats.document_ids.bytes },
+                { "positions_bytes", stats.positions.bytes },
+                { "impacts_bytes", stats.impacts.bytes },
+                { "typos_bytes", stats.typos.bytes },
+            };
+            for (const auto& [name, value] : values) {
+                answer += '\t';
+                answer += name;
+                answer += '\t' + std::to_string(value);
+            }
+        }
+        else if (command == "PING" && fields.size() == 1) {
+        }
+        else {
+            throw std::runtime_error("Unknown request");
+        }
+        return answer;
+    });
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Request lines, fields separated by '\t', answered in the order they arrive on a connection:
+//   FIND <query>                 -> OK (<id> <relevance> <rating>)*
+//   FIND <status> <query>        -> OK (<id> <relevance> <rating>)*
+//   MATCH <id> <query>           -> OK <status> <word>*
+//   EXPLAIN <query>              -> OK <evaluation> (<+|-><term> <postings>)*   in evaluation order
+//   STATS                        -> OK (<name> <value>)*      index sizes and memory, for metrics scrapers
+//   PING                         -> OK
+// Failures are answered with ERR <exception kind> <message>. The last request may end with the
+// connection instead of a newline.
+struct QueryServerOptions {
+    std::string host = "127.0.0.1";
+    int port = 7700;
+    size_t worker_count = 4;
+    // A worker takes up to this many queued requests at once, so under load the cost of
+    // waking workers and the event loop is shared by the whole batch.
+    size_t max_batch_size = 32;
+    // Reading from a connection pauses while this many of its requests are unanswered.
+    size_t max_pending_per_connection = 1024;
+    // A connection whose unfinished request line grows past this many bytes is answered
+    // ERR and closed once its earlier requests are answered.
+    size_t max_request_length = 1 << 20;
+};
+
+// Asynchronous server over a read-only SearchServer: one epoll thread owns all sockets and
+// keeps many pipelined requests per connection in flight, a fixed worker pool runs the queries.
+class QueryServer {
+public:
+    explicit QueryServer(const SearchServer& search_server, const QueryServerOptions& options = {});
+
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    int GetPort() const;
+
+    // Serves connections in the calling thread until Stop is called.
+    void Run();
+
+    // Safe to call from any thread.
+    void Stop();
+
+    std::string HandleRequest(const std::string_view request) const;
+
+private:
+    struct Task {
+        std::uint64_t connection_id;
+        std::uint64_t sequence;
+        std::string request;
+    };
+
+    struct Completion {
+        std::uint64_t connection_id;
+        std::uint64_t sequence;
+        std::string response;
+    };
+
+    struct Connection {
+        int descriptor = -1;
+        std::string input;
+        std::string output;
+        std::uint64_t next_sequence = 0;
+        std::uint64_t next_to_send = 0;
+        std::map<std::uint64_t, std::string> ready_responses;
+        std::uint32_t events = 0;
+        bool peer_closed = false;
+    };
+
+    const SearchServer& search_server_;
+    const QueryServerOptions options_;
+    const int listen_descriptor_;
+    const int epoll_descriptor_;
+    const int wake_descriptor_;
+    std::atomic<bool> stopping_ = false;
+
+    std::map<std::uint64_t, Connection> connections_;
+    std::uint64_t next_connection_id_ = 2;
+
+    std::mutex tasks_mutex_;
+    std::condition_variable tasks_ready_;
+    std::deque<Task> tasks_;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    std::vector<std::thread> workers_;
+
+    void RunWorker();
+
+    void AcceptConnections();
+
+    void ReadRequests(std::uint64_t connection_id, Connection& connection);
+
+    void DeliverCompletions();
+
+    // Moves the answers that are next in request order to the output.
+    void QueueReadyResponses(Connection& connection);
+
+    void WriteResponses(Connection& connection);
+
+    void UpdateEvents(std::uint64_t connection_id, Connection& connection);
+
+    void CloseConnection(std::uint64_t connection_id);
+};
@@ -0,0 +1,115 @@
+#include "corpus_generator.h"
+#include "corpus_loader.h"
+#include "query_server.h"
+#include "search_server.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Serves a corpus file, or a synthetic corpus when none is given; search_load_generator with the same
+// corpus options sends matching queries.
+// Usage: search_query_server [--port=N] [--workers=N] [--batch=N] [--documents=N] [--vocabulary=N]
+//        [--words-per-document=N] [--zipf=S] [--seed=N]
+//        [--corpus=FILE [--format=tsv|jsonl] [--stop-words="..."]]
+int main(int argc, char** argv) {
+    QueryServerOptions server_options;
+    CorpusOptions corpus_options;
+    corpus_options.query_count = 0;
+    string corpus_path;
+    CorpusLoadOptions load_options;
+    string stop_words;
+
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const auto equals = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || equals == string::npos) {
+            cerr << "Unknown argument "s << argument << endl;
+            return 2;
+        }
+        const string name = argument.substr(2, equals - 2);
+        const string value = argument.substr(equals + 1);
+        if (name == "port") {
+            server_options.port = stoi(value);
+        }
+        else if (name == "workers") {
+            server_options.worker_count = stoul(value);
+        }
+        else if (name == "batch") {
+            server_options.max_batch_size = stoul(value);
+        }
+        else if (name == "documents") {
+            corpus_options.document_count = stoul(value);
+        }
+        else if (name == "vocabulary") {
+            corpus_options.vocabulary_size = stoul(value);
+        }
+        else if (name == "words-per-document") {
+            corpus_options.words_per_document = stoul(value);
+        }
+        else if (name == "zipf") {
+            corpus_options.zipf_exponent = stod(value);
+        }
+        else if (name == "seed") {
+            corpus_options.seed = stoull(value);
+        }
+        else if (name == "corpus") {
+            corpus_path = value;
+        }
+        else if (name == "format") {
+            load_options.format = ParseCorpusFormat(value);
+        }
+        else if (name == "stop-words") {
+            stop_words = value;
+        }
+        else {
+            cerr << "Unknown argument "s << argument << endl;
+            return 2;
+        }
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    SyntheticCorpus corpus;
+    if (corpus_path.empty()) {
+        corpus = GenerateCorpus(corpus_options);
+        stop_words = corpus.stop_words;
+    }
+    SearchServer search_server(stop_words);
+    if (corpus_path.empty()) {
+        for (const auto& document : corpus.documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    }
+    else {
+        load_options.on_progress = [](const CorpusLoadProgress& progress) {
+            cerr << "\rLoaded "s << progress.documents_loaded << " documents, "s
+                 << progress.bytes_done * 100 / max<size_t>(progress.bytes_total, 1) << "%, "s
+                 << static_cast<size_t>(progress.bytes_done / 1e6 / max(progress.seconds, 1e-9)) << " MB/s"s << flush;
+        };
+        LoadCorpus(search_server, corpus_path, load_options);
+        cerr << endl;
+    }
+
+    QueryServer query_server(search_server, server_options);
+    cerr << "Serving "s << search_server.GetDocumentCount() << " documents on port "s << query_server.GetPort() << endl;
+
+    thread([&query_server, signals] {
+        int signal_number = 0;
+        sigwait(&signals, &signal_number);
+        query_server.Stop();
+    }).detach();
+
+    query_server.Run();
+    return 0;
+}
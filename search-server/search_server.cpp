@@ -1,12 +1,50 @@
 #include "search_server.h"
+#include "binary_io.h"
+
+#include <tuple>
+
+namespace {
+
+// Impact-ordered evaluation is planned when there are at least this many candidate documents per
+// requested result; with fewer it reads most postings anyway, at a higher price per posting.
+const size_t MIN_IMPACT_CANDIDATES_PER_RESULT = 4;
+// Deep pages need a low threshold, which is only reached after most postings are read.
+const size_t MAX_IMPACT_RESULT_COUNT = 100;
+
+}  // namespace
+
+std::string_view GetQueryEvaluationName(QueryEvaluation evaluation) {
+    switch (evaluation) {
+    case QueryEvaluation::EMPTY:
+        return "empty";
+    case QueryEvaluation::TERM_AT_A_TIME:
+        return "term_at_a_time";
+    case QueryEvaluation::DOCUMENT_AT_A_TIME:
+        return "document_at_a_time";
+    case QueryEvaluation::IMPACT_ORDERED:
+        return "impact_ordered";
+    }
+    return "unknown";
+}
+
+void TermStatistics::Merge(const TermStatistics& other) {
+    document_count += other.document_count;
+    for (const auto& [word, document_freq] : other.document_freqs) {
+        document_freqs[word] += document_freq;
+    }
+}
 
+SearchServer::SearchServer(const std::string& stop_words_text, const SearchServerOptions& options)
+    : SearchServer(SplitIntoWords(stop_words_text), options)
+{}
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const std::string_view stop_words_text, const SearchServerOptions& options)
+    : SearchServer(SplitIntoWords(stop_words_text), options)
 {}
 
-SearchServer::SearchServer(const std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const SearchServerOptions& options, std::set<std::string, std::less<>> normalized_stop_words)
+    : options_(options)
+    , stop_words_(std::move(normalized_stop_words))
 {}
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
@@ -16,14 +54,48 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
     if (documents_.count(document_id) > 0) {
         throw std::invalid_argument("The document id must be unique, such id already exists");
     }
-    const auto words = SplitIntoWordsNoStop(document);
+    AddTokenizedDocument(document_id, TokenizeDocument(document), status, ratings);
+}
+
+TokenizedDocument SearchServer::TokenizeDocument(const std::string_view document) const {
+    TokenizedDocument tokenized;
+    normalizer_.ForEachTerm(document, [this, &tokenized](std::string_view word, bool borrowed) {
+        if (!IsStopWord(word)) {
+            tokenized.words.push_back(borrowed ? word : std::string_view(tokenized.normalized_words.emplace_back(word)));
+        }
+        });
+    return tokenized;
+}
+
+void SearchServer::AddTokenizedDocument(int document_id, const TokenizedDocument& document, DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("The document id must be non-negative");
+    }
+    if (documents_.count(document_id) > 0) {
+        throw std::invalid_argument("The document id must be unique, such id already exists");
+    }
 
+    const std::vector<std::string_view>& words = document.words;
     const double inv_word_count = 1.0 / words.size();
-    for (const auto word : words) {
-        auto it = words_.insert(std::string(word));
-        std::string_view word_pointer = *(it.first);
+    for (size_t position = 0; position < words.size(); ++position) {
+        // Only words new to the index are copied; known ones reuse the stored string.
+        auto it = words_.find(words[position]);
+        if (it == words_.end()) {
+            it = words_.emplace(words[position]).first;
+            typo_index_.Add(*it);
+        }
+        const std::string_view word_pointer = *it;
         word_to_document_freqs_[word_pointer][document_id] += inv_word_count;
         document_to_word_freqs_[document_id][word_pointer] += inv_word_count;
+        if (options_.positional_index) {
+            word_to_document_positions_[word_pointer][document_id].Append(static_cast<std::uint32_t>(position));
+        }
+    }
+    // Frequencies are final only after the whole document is counted.
+    if (options_.impact_ordered_postings) {
+        for (const auto& [word, term_freq] : GetWordFrequencies(document_id)) {
+            word_to_document_impacts_[word].emplace(term_freq, document_id);
+        }
     }
     documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
     document_ids_.insert(document_id);
@@ -37,15 +109,74 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
     return FindTopDocuments(std::execution::seq, raw_query);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, offset, limit);
+}
+
+std::pair<std::vector<Document>, QueryTrace> SearchServer::FindTopDocumentsTraced(const std::string_view raw_query) const {
+    return FindTopDocumentsTraced(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+TermStatistics SearchServer::CollectTermStatistics(const std::string_view raw_query) const {
+    TermStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    const QueryArenaScope arena;
+    Query query(arena.GetResource());
+    query.keep_all_candidates = true;
+    ParseQueryText(raw_query, query);
+    MergeTypoCorrections(query);
+    // Minus words count too: the expansions of minus patterns are picked by the merged counts.
+    for (const auto* words : { &query.plus_words, &query.minus_words }) {
+        for (const std::string_view word : *words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+                statistics.document_freqs.emplace(word, static_cast<int>(it->second.size()));
+            }
+        }
+    }
+    return statistics;
+}
+
+QueryPlan SearchServer::ExplainQuery(const std::string_view raw_query) const {
+    const QueryArenaScope arena;
+    const Query query = ParseQuery(raw_query, arena.GetResource());
+    const Plan plan = PlanQuery(query, MAX_RESULT_DOCUMENT_COUNT);
+
+    QueryPlan explanation;
+    explanation.evaluation = plan.evaluation;
+    explanation.phrase_count = query.phrases.size();
+    explanation.term_at_a_time_cost = plan.term_at_a_time_cost;
+    explanation.document_at_a_time_cost = plan.document_at_a_time_cost;
+    for (const PlannedPostings& term : plan.plus_terms) {
+        const auto typo = query.typo_weights.find(term.word);
+        explanation.plus_terms.push_back({ std::string(term.word), term.postings->size(), typo == query.typo_weights.end() ? 1.0 : typo->second });
+    }
+    for (const PlannedPostings& term : plan.minus_terms) {
+        explanation.minus_terms.push_back({ std::string(term.word), term.postings->size(), 1.0 });
+    }
+    for (const auto* words : { &query.plus_words, &query.minus_words }) {
+        for (const std::string_view word : *words) {
+            if (FindPostings(word) == nullptr) {
+                explanation.missing_terms.emplace_back(word);
+            }
+        }
+    }
+    return explanation;
+}
+
 int SearchServer::GetDocumentCount() const {
     return (int)documents_.size();
 }
 
-std::set<int>::const_iterator SearchServer::begin() const {
+bool SearchServer::HasDocument(int document_id) const {
+    return document_ids_.count(document_id) > 0;
+}
+
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
+std::pmr::set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
@@ -54,27 +185,32 @@ std::pair<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocu
         throw std::out_of_range("out_of_range");
     }
 
-    const auto query = SearchServer::ParseQuery(std::execution::seq, raw_query);
+    const QueryArenaScope arena;
+    const auto query = SearchServer::ParseQuery(std::execution::seq, raw_query, arena.GetResource());
     std::vector<std::string_view> matched_words;
-    const std::map<std::string_view, double>& word_freq = GetWordFrequencies(document_id);
+    matched_words.reserve(query.plus_words.size());
+    const auto& word_freq = GetWordFrequencies(document_id);
 
     if (any_of(query.minus_words.begin(), query.minus_words.end(),
         [&word_freq](const auto& word) { return word_freq.count(word); }
-    ))
+    ) || !MatchesPhrases(query, document_id))
     {
         return { {}, documents_.at(document_id).status };
     }
 
-    copy_if(query.plus_words.begin(), query.plus_words.end(), std::back_inserter(matched_words),
-        [&word_freq, &matched_words](std::string_view word) {
-            return word_freq.count(word);
-        });
+    // Normalized query terms live in the arena; the index's copies outlive the call.
+    for (const std::string_view word : query.plus_words) {
+        const auto it = word_freq.find(word);
+        if (it != word_freq.end()) {
+            matched_words.push_back(it->first);
+        }
+    }
 
     sort(matched_words.begin(), matched_words.end());
     auto last = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(last, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { std::move(matched_words), documents_.at(document_id).status };
 }
 
 std::pair<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query, int document_id) const {
@@ -87,66 +223,140 @@ std::pair<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocu
         throw std::out_of_range("out_of_range");
     }
 
-    const auto query = ParseQuery(std::execution::par, raw_query);
+    const QueryArenaScope arena;
+    const auto query = ParseQuery(std::execution::par, raw_query, arena.GetResource());
     std::vector<std::string_view> matched_words;
     matched_words.reserve(query.plus_words.size());
 
-    const std::map<std::string_view, double>& word_freq = GetWordFrequencies(document_id);
+    const auto& word_freq = GetWordFrequencies(document_id);
 
     bool is_minus = any_of(query.minus_words.begin(), query.minus_words.end(),
         [&word_freq](const auto& word) { return word_freq.count(word); }
     );
-    if (is_minus)
+    if (is_minus || !MatchesPhrases(query, document_id))
     {
         return { {}, documents_.at(document_id).status };
     }
 
-    copy_if(query.plus_words.begin(), query.plus_words.end(),
-        std::back_inserter(matched_words),
-        [&word_freq, &matched_words](std::string_view word) {
-            return word_freq.count(word);
-        });
+    for (const std::string_view word : query.plus_words) {
+        const auto it = word_freq.find(word);
+        if (it != word_freq.end()) {
+            matched_words.push_back(it->first);
+        }
+    }
 
     sort(matched_words.begin(), matched_words.end());
     auto last = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(last, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { std::move(matched_words), documents_.at(document_id).status };
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-bool SearchServer::IsValidWord(const std::string_view word) {
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-        });
+int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
+    if (ratings.empty()) {
+        return 0;
+    }
+    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
+    return rating_sum / static_cast<int>(ratings.size());
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Some words have invalid symbols");
+double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word, const TermStatistics* statistics) const {
+    if (statistics) {
+        const auto it = statistics->document_freqs.find(word);
+        if (it != statistics->document_freqs.end() && it->second > 0) {
+            return std::log(statistics->document_count * 1.0 / it->second);
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+    }
+    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        // Full ties are ordered by id, so that merged shard results come out in the same order.
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
         }
+        return lhs.rating > rhs.rating;
+    }
+    else {
+        return lhs.relevance > rhs.relevance;
     }
-    return words;
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
-    if (ratings.empty()) {
-        return 0;
+const std::pmr::map<int, double>* SearchServer::FindPostings(const std::string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    return it == word_to_document_freqs_.end() || it->second.empty() ? nullptr : &it->second;
+}
+
+SearchServer::Plan SearchServer::PlanQuery(const Query& query, size_t result_count) const {
+    Plan plan(query.plus_words.get_allocator().resource());
+    plan.result_count = result_count;
+    size_t posting_count = 0;
+    bool has_negative_score = false;
+    for (const std::string_view word : query.plus_words) {
+        if (const auto* postings = FindPostings(word)) {
+            const ImpactList* impacts = options_.impact_ordered_postings ? &word_to_document_impacts_.at(word) : nullptr;
+            double inverse_document_freq = ComputeWordInverseDocumentFreq(word, query.statistics);
+            if (const auto typo = query.typo_weights.find(word); typo != query.typo_weights.end()) {
+                inverse_document_freq *= typo->second;
+            }
+            plan.plus_terms.push_back({ word, postings, impacts, inverse_document_freq });
+            has_negative_score = has_negative_score || plan.plus_terms.back().inverse_document_freq < 0;
+            posting_count += postings->size();
+        }
     }
-    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
-    return rating_sum / static_cast<int>(ratings.size());
+    // A phrase needs all of its words, so one missing word rules out every document.
+    const bool has_missing_phrase_word = std::any_of(query.phrases.begin(), query.phrases.end(), [this](const Phrase& phrase) {
+        return std::any_of(phrase.words.begin(), phrase.words.end(), [this](std::string_view word) { return FindPostings(word) == nullptr; });
+        });
+    if (plan.plus_terms.empty() || has_missing_phrase_word) {
+        plan.plus_terms.clear();
+        return plan;
+    }
+    for (const std::string_view word : query.minus_words) {
+        if (const auto* postings = FindPostings(word)) {
+            plan.minus_terms.push_back({ word, postings, nullptr, 0.0 });
+        }
+    }
+
+    const auto shorter = [](const PlannedPostings& lhs, const PlannedPostings& rhs) {
+        return std::pair(lhs.postings->size(), lhs.word) < std::pair(rhs.postings->size(), rhs.word);
+    };
+    std::sort(plan.plus_terms.begin(), plan.plus_terms.end(), shorter);
+    std::sort(plan.minus_terms.begin(), plan.minus_terms.end(), shorter);
+
+    // Term at a time pays a document lookup and an accumulator update per posting; document at a
+    // time pays a pass over all cursors and one document lookup per candidate.
+    const double candidate_count = std::min<double>(posting_count, GetDocumentCount());
+    const double document_lookup = std::log2(GetDocumentCount() + 1.0);
+    plan.term_at_a_time_cost = posting_count * (document_lookup + std::log2(candidate_count + 1.0));
+    plan.document_at_a_time_cost = posting_count + candidate_count * (plan.plus_terms.size() + document_lookup);
+    plan.evaluation = plan.document_at_a_time_cost < plan.term_at_a_time_cost
+        ? QueryEvaluation::DOCUMENT_AT_A_TIME
+        : QueryEvaluation::TERM_AT_A_TIME;
+
+    // Reading by impact pays off when few of many candidates are wanted; the stop rule assumes
+    // that scores only grow with term frequency.
+    if (options_.impact_ordered_postings && result_count > 0 && result_count <= MAX_IMPACT_RESULT_COUNT
+        && !has_negative_score && candidate_count >= result_count * MIN_IMPACT_CANDIDATES_PER_RESULT) {
+        plan.evaluation = QueryEvaluation::IMPACT_ORDERED;
+    }
+    return plan;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+size_t SearchServer::CountPostings(const std::pmr::vector<std::string_view>& words) const {
+    size_t postings = 0;
+    for (const std::string_view word : words) {
+        auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            postings += it->second.size();
+        }
+    }
+    return postings;
 }
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
@@ -160,33 +370,239 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-') {
         throw std::invalid_argument("Invalid search request");
     }
+    return QueryWord{ word, is_minus };
+}
 
-    return QueryWord{ word, is_minus, IsStopWord(text) };
+std::pmr::vector<std::string_view> SearchServer::ExpandTermPattern(const std::string_view pattern, const Query& query) const {
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    const std::string_view prefix = pattern.substr(0, pattern.find_first_of("*?"));
+    const bool is_prefix_pattern = pattern.size() == prefix.size() + 1 && pattern.back() == '*';
+
+    // Both words_ and the statistics are ordered, so every term with the literal prefix lies in
+    // one contiguous range.
+    std::pmr::vector<std::pair<size_t, std::string_view>> candidates(resource);
+    size_t scanned = 0;
+    // Returns false past the end of the range.
+    const auto consider = [&](std::string_view term, const auto& get_document_count) {
+        if (term.compare(0, prefix.size(), prefix) != 0 || scanned++ == MAX_TERM_EXPANSION_SCAN) {
+            return false;
+        }
+        if (is_prefix_pattern || MatchesWildcard(pattern, term)) {
+            if (const size_t document_count = get_document_count(); document_count > 0) {
+                candidates.emplace_back(document_count, term);
+            }
+        }
+        return true;
+    };
+    if (query.statistics) {
+        const auto& document_freqs = query.statistics->document_freqs;
+        for (auto it = document_freqs.lower_bound(prefix);
+            it != document_freqs.end() && consider(it->first, [it] { return static_cast<size_t>(it->second); });
+            ++it) {
+        }
+    }
+    else {
+        for (auto it = words_.lower_bound(prefix);
+            it != words_.end() && consider(*it, [this, it] { const auto* postings = FindPostings(*it); return postings ? postings->size() : size_t{ 0 }; });
+            ++it) {
+        }
+    }
+
+    // Keep the terms with the longest posting lists: they carry most of the matches. Ties go to
+    // the smaller term, so that every shard keeps the same ones.
+    if (!query.keep_all_candidates && candidates.size() > MAX_TERM_EXPANSION_COUNT) {
+        std::nth_element(candidates.begin(), candidates.begin() + MAX_TERM_EXPANSION_COUNT, candidates.end(),
+            [](const auto& lhs, const auto& rhs) { return std::tuple(rhs.first, lhs.second) < std::tuple(lhs.first, rhs.second); });
+        candidates.resize(MAX_TERM_EXPANSION_COUNT);
+    }
+
+    std::pmr::vector<std::string_view> terms(resource);
+    terms.reserve(candidates.size());
+    for (const auto& [_, term] : candidates) {
+        // Terms of other shards are dropped, those of this one are viewed in the index.
+        if (const auto it = words_.find(term); it != words_.end()) {
+            terms.push_back(*it);
+        }
+    }
+    return terms;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
-    Query query;
+void SearchServer::AddTypoCorrections(const std::string_view word, Query& query) const {
+    if (options_.max_typo_edits == 0 || options_.max_typo_expansions == 0) {
+        return;
+    }
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    std::pmr::vector<std::pair<TypoMatch, size_t>> corrections(resource);
+    if (query.statistics) {
+        // The merged counts hold every candidate of every shard, and the word itself if any shard
+        // has it.
+        const auto& document_freqs = query.statistics->document_freqs;
+        if (const auto it = document_freqs.find(word); it != document_freqs.end() && it->second > 0) {
+            return;
+        }
+        const size_t max_edits = typo_index_.GetAllowedEdits(word);
+        for (const auto& [term, document_count] : document_freqs) {
+            if (const size_t edit_count = typo_index_.CountTypos(word, term); edit_count <= max_edits && document_count > 0) {
+                corrections.push_back({ { term, edit_count }, static_cast<size_t>(document_count) });
+            }
+        }
+    }
+    else {
+        if (FindPostings(word) != nullptr) {
+            return;
+        }
+        for (const TypoMatch& match : typo_index_.FindMatches(word, resource)) {
+            // Terms of removed documents stay in the dictionary without postings.
+            if (const auto* postings = FindPostings(match.term)) {
+                corrections.emplace_back(match, postings->size());
+            }
+        }
+    }
 
-    for (const auto word : SplitIntoWords(text)) {
-        QueryWord query_word = ParseQueryWord(word);
+    const auto better = [](const std::pair<TypoMatch, size_t>& lhs, const std::pair<TypoMatch, size_t>& rhs) {
+        return std::tuple(lhs.first.edit_count, rhs.second, lhs.first.term) < std::tuple(rhs.first.edit_count, lhs.second, rhs.first.term);
+    };
+    const size_t count = query.keep_all_candidates ? corrections.size() : std::min(corrections.size(), options_.max_typo_expansions);
+    std::partial_sort(corrections.begin(), corrections.begin() + count, corrections.end(), better);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& [match, _] = corrections[i];
+        // Terms of other shards are dropped, those of this one are viewed in the index.
+        const auto term = words_.find(match.term);
+        if (term == words_.end()) {
+            continue;
+        }
+        const double weight = std::pow(options_.typo_weight, static_cast<double>(match.edit_count));
+        // A term close to two misspelled words keeps the higher weight.
+        const auto it = query.typo_weights.emplace(*term, weight).first;
+        it->second = std::max(it->second, weight);
+    }
+}
 
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+void SearchServer::ParseQueryWords(const std::string_view text, Query& query) const {
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    const auto words = SplitIntoWords(text, resource);
+    if (words.empty()) {
+        throw std::invalid_argument("Invalid search request");
+    }
+    for (const auto word : words) {
+        const QueryWord query_word = ParseQueryWord(word);
+        auto& target = query_word.is_minus ? query.minus_words : query.plus_words;
+        // One query word may normalize to several terms: "-new-york" excludes both halves.
+        normalizer_.ForEachTerm(query_word.data, [this, &query, &query_word, &target, resource](std::string_view term, bool borrowed) {
+            if (IsWildcardPattern(term)) {
+                if (term[0] == '*' || term[0] == '?') {
+                    throw std::invalid_argument("Wildcard patterns must start with a literal prefix");
+                }
+                const auto terms = ExpandTermPattern(term, query);
+                target.insert(target.end(), terms.begin(), terms.end());
             }
-            else {
-                query.plus_words.push_back(query_word.data);
+            else if (!IsStopWord(term)) {
+                target.push_back(query.KeepTerm(term, borrowed));
+                if (!query_word.is_minus) {
+                    AddTypoCorrections(target.back(), query);
+                }
             }
+            }, true);
+    }
+}
+
+SearchServer::Phrase SearchServer::ParsePhrase(const std::string_view text, Query& query) const {
+    Phrase phrase(query.phrases.get_allocator().resource());
+    for (const auto word : SplitIntoWords(text, phrase.words.get_allocator().resource())) {
+        const QueryWord query_word = ParseQueryWord(word);
+        if (query_word.is_minus) {
+            throw std::invalid_argument("Minus words and patterns are not allowed inside a phrase");
         }
+        normalizer_.ForEachTerm(query_word.data, [this, &query, &phrase](std::string_view term, bool borrowed) {
+            if (IsWildcardPattern(term)) {
+                throw std::invalid_argument("Minus words and patterns are not allowed inside a phrase");
+            }
+            // Stop words are not indexed, so positions of the remaining words are adjacent.
+            if (!IsStopWord(term)) {
+                phrase.words.push_back(query.KeepTerm(term, borrowed));
+            }
+            }, true);
     }
+    return phrase;
+}
+
+void SearchServer::ParseQueryText(std::string_view text, Query& query) const {
+    bool has_phrases = false;
+    while (true) {
+        const auto quote = text.find('"');
+        std::string_view plain = text.substr(0, quote);
+        if (quote != text.npos) {
+            plain = plain.substr(0, plain.find_last_not_of(WHITESPACE) + 1);
+        }
+        // An empty request is still rejected by ParseQueryWords, empty gaps around phrases are not.
+        if ((!has_phrases && quote == text.npos) || plain.find_first_not_of(WHITESPACE) != plain.npos) {
+            ParseQueryWords(plain, query);
+        }
+        if (quote == text.npos) {
+            break;
+        }
+
+        const auto closing_quote = text.find('"', quote + 1);
+        if (closing_quote == text.npos) {
+            throw std::invalid_argument("Unclosed quote in search request");
+        }
+        if (!options_.positional_index) {
+            throw std::invalid_argument("Phrase search requires the positional index");
+        }
+        Phrase phrase = ParsePhrase(text.substr(quote + 1, closing_quote - quote - 1), query);
+        text.remove_prefix(closing_quote + 1);
+        has_phrases = true;
+
+        if (!text.empty() && text[0] == '~') {
+            const auto slop_end = std::min(text.find_first_of(WHITESPACE), text.size());
+            const std::string_view slop_text = text.substr(1, slop_end - 1);
+            if (slop_text.empty() || slop_text.size() > 4
+                || !std::all_of(slop_text.begin(), slop_text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                throw std::invalid_argument("Invalid phrase slop in search request");
+            }
+            phrase.slop = std::stoi(std::string(slop_text));
+            text.remove_prefix(slop_end);
+        }
+
+        query.plus_words.insert(query.plus_words.end(), phrase.words.begin(), phrase.words.end());
+        if (phrase.words.size() > 1) {
+            query.phrases.push_back(std::move(phrase));
+        }
+    }
+}
+
+void SearchServer::MergeTypoCorrections(Query& query) {
+    // A correction the query also has as typed counts in full.
+    const size_t typed_count = query.plus_words.size();
+    for (auto it = query.typo_weights.begin(); it != query.typo_weights.end();) {
+        const auto typed_end = query.plus_words.begin() + typed_count;
+        if (std::find(query.plus_words.begin(), typed_end, it->first) != typed_end) {
+            it = query.typo_weights.erase(it);
+        }
+        else {
+            query.plus_words.push_back(it->first);
+            ++it;
+        }
+    }
+}
+
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, std::pmr::memory_resource* resource, const TermStatistics* statistics) const {
+    Query query(resource);
+    query.statistics = statistics;
+    ParseQueryText(text, query);
 
     std::sort(query.plus_words.begin(), query.plus_words.end());
     auto to_erase = std::unique(query.plus_words.begin(), query.plus_words.end());
     query.plus_words.erase(to_erase, query.plus_words.end());
 
+    if (!query.typo_weights.empty()) {
+        MergeTypoCorrections(query);
+        std::sort(query.plus_words.begin(), query.plus_words.end());
+    }
+
     std::sort(query.minus_words.begin(), query.minus_words.end());
     to_erase = std::unique(query.minus_words.begin(), query.minus_words.end());
     query.minus_words.erase(to_erase, query.minus_words.end());
@@ -194,30 +610,202 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
     return query;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::execution::sequenced_policy& policy, const std::string_view text) const {
-    return SearchServer::ParseQuery(text);
+SearchServer::Query SearchServer::ParseQuery(const std::execution::sequenced_policy& policy, const std::string_view text, std::pmr::memory_resource* resource, const TermStatistics* statistics) const {
+    return SearchServer::ParseQuery(text, resource, statistics);
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_policy& policy, const std::string_view text) const {
-    Query query;
+SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_policy& policy, const std::string_view text, std::pmr::memory_resource* resource) const {
+    Query query(resource);
+    ParseQueryText(text, query);
+    MergeTypoCorrections(query);
+    return query;
+}
 
-    for (const auto word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
+bool SearchServer::MatchesPhrases(const Query& query, int document_id) const {
+    std::pmr::vector<const PositionList*> term_positions(query.phrases.get_allocator().resource());
+    for (const Phrase& phrase : query.phrases) {
+        term_positions.clear();
+        for (const std::string_view word : phrase.words) {
+            const auto word_it = word_to_document_positions_.find(word);
+            if (word_it == word_to_document_positions_.end()) {
+                return false;
+            }
+            const auto document_it = word_it->second.find(document_id);
+            if (document_it == word_it->second.end()) {
+                return false;
+            }
+            term_positions.push_back(&document_it->second);
+        }
+        if (!ContainsPhrase(term_positions, phrase.slop)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SearchServer::IndexMemory::IndexMemory(std::pmr::memory_resource* upstream)
+    : words(upstream ? upstream : std::pmr::get_default_resource())
+    , word_to_document_freqs(upstream ? upstream : std::pmr::get_default_resource())
+    , document_to_word_freqs(upstream ? upstream : std::pmr::get_default_resource())
+    , documents(upstream ? upstream : std::pmr::get_default_resource())
+    , document_ids(upstream ? upstream : std::pmr::get_default_resource())
+    , positions(upstream ? upstream : std::pmr::get_default_resource())
+    , impacts(upstream ? upstream : std::pmr::get_default_resource())
+    , typos(upstream ? upstream : std::pmr::get_default_resource()) {
+}
+
+size_t SearchServer::GetPositionalIndexMemoryUsage() const {
+    return memory_->positions.GetBytes();
+}
+
+SearchServerStats SearchServer::GetStats(size_t largest_term_count) const {
+    SearchServerStats stats;
+    stats.document_count = documents_.size();
+
+    const auto read = [](const CountingMemoryResource& resource) {
+        return IndexStructureMemory{ resource.GetBytes(), resource.GetAllocationCount() };
+    };
+    stats.words = read(memory_->words);
+    stats.word_to_document_freqs = read(memory_->word_to_document_freqs);
+    stats.document_to_word_freqs = read(memory_->document_to_word_freqs);
+    stats.documents = read(memory_->documents);
+    stats.document_ids = read(memory_->document_ids);
+    stats.positions = read(memory_->positions);
+    stats.impacts = read(memory_->impacts);
+    stats.typos = read(memory_->typos);
+    stats.total_bytes = stats.words.bytes + stats.word_to_document_freqs.bytes + stats.document_to_word_freqs.bytes
+        + stats.documents.bytes + stats.document_ids.bytes + stats.positions.bytes + stats.impacts.bytes
+        + stats.typos.bytes;
+
+    // Min-heap of the longest lists seen so far; its top is the first to be displaced.
+    const auto longer = [](const std::pair<std::string_view, size_t>& lhs, const std::pair<std::string_view, size_t>& rhs) {
+        return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+    };
+    std::vector<std::pair<std::string_view, size_t>> largest;
+    largest.reserve(largest_term_count + 1);
+    for (const auto& [word, document_freqs] : word_to_document_freqs_) {
+        const size_t length = document_freqs.size();
+        if (length == 0) {
+            continue;
+        }
+        ++stats.term_count;
+        stats.posting_count += length;
 
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+        size_t bucket = 0;
+        while ((length >> (bucket + 1)) > 0) {
+            ++bucket;
+        }
+        if (stats.posting_length_histogram.size() <= bucket) {
+            stats.posting_length_histogram.resize(bucket + 1);
+        }
+        ++stats.posting_length_histogram[bucket];
+
+        if (largest_term_count > 0) {
+            largest.emplace_back(word, length);
+            std::push_heap(largest.begin(), largest.end(), longer);
+            if (largest.size() > largest_term_count) {
+                std::pop_heap(largest.begin(), largest.end(), longer);
+                largest.pop_back();
             }
-            else {
-                query.plus_words.push_back(query_word.data);
+        }
+    }
+
+    std::sort_heap(largest.begin(), largest.end(), longer);
+    for (const auto& [word, length] : largest) {
+        stats.largest_terms.emplace_back(std::string(word), length);
+    }
+    return stats;
+}
+
+namespace {
+
+const std::uint32_t SNAPSHOT_MAGIC = 0x53534E50;  // "SSNP"
+// Version 2: terms and stop words are normalized.
+const std::uint32_t SNAPSHOT_VERSION = 2;
+
+}  // namespace
+
+void SearchServer::WriteSnapshot(std::ostream& out) const {
+    WriteBinary(out, SNAPSHOT_MAGIC);
+    WriteBinary(out, SNAPSHOT_VERSION);
+    WriteBinary(out, static_cast<std::uint8_t>(options_.positional_index));
+    WriteBinary(out, static_cast<std::uint32_t>(stop_words_.size()));
+    for (const std::string& stop_word : stop_words_) {
+        WriteBinaryString(out, stop_word);
+    }
+
+    std::pmr::vector<std::uint32_t> positions;
+    WriteBinary(out, static_cast<std::uint32_t>(documents_.size()));
+    for (const auto& [document_id, data] : documents_) {
+        WriteBinary(out, static_cast<std::int32_t>(document_id));
+        WriteBinary(out, static_cast<std::int32_t>(data.rating));
+        WriteBinary(out, static_cast<std::int32_t>(data.status));
+        // Documents of stop words only have no entry and are written with an empty word list.
+        const auto& word_freqs = GetWordFrequencies(document_id);
+        WriteBinary(out, static_cast<std::uint32_t>(word_freqs.size()));
+        for (const auto& [word, term_freq] : word_freqs) {
+            WriteBinaryString(out, word);
+            // Frequencies are stored bit-exact, a restored index ranks exactly like the original.
+            WriteBinary(out, term_freq);
+            if (options_.positional_index) {
+                word_to_document_positions_.at(word).at(document_id).DecodeTo(positions);
+                WriteBinary(out, static_cast<std::uint32_t>(positions.size()));
+                for (const std::uint32_t position : positions) {
+                    WriteBinary(out, position);
+                }
             }
         }
     }
-    return query;
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static std::map<std::string_view, double> result;
+SearchServer SearchServer::ReadSnapshot(std::istream& in, const SearchServerOptions& server_options) {
+    if (ReadBinary<std::uint32_t>(in) != SNAPSHOT_MAGIC || ReadBinary<std::uint32_t>(in) != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Not a search server snapshot");
+    }
+    SearchServerOptions options = server_options;
+    options.positional_index = ReadBinary<std::uint8_t>(in) != 0;
+    std::set<std::string, std::less<>> stop_words;
+    for (std::uint32_t i = ReadBinary<std::uint32_t>(in); i > 0; --i) {
+        stop_words.insert(ReadBinaryString(in));
+    }
+
+    // Stored terms are normalized already; running a stemmer over them again could change them.
+    SearchServer search_server(options, std::move(stop_words));
+    const std::uint32_t document_count = ReadBinary<std::uint32_t>(in);
+    for (std::uint32_t i = 0; i < document_count; ++i) {
+        const int document_id = ReadBinary<std::int32_t>(in);
+        const int rating = ReadBinary<std::int32_t>(in);
+        const auto status = static_cast<DocumentStatus>(ReadBinary<std::int32_t>(in));
+        auto& word_freqs = search_server.document_to_word_freqs_[document_id];
+        const std::uint32_t word_count = ReadBinary<std::uint32_t>(in);
+        for (std::uint32_t j = 0; j < word_count; ++j) {
+            const auto [word_it, is_new_word] = search_server.words_.emplace(ReadBinaryString(in));
+            const std::string_view word = *word_it;
+            if (is_new_word) {
+                search_server.typo_index_.Add(word);
+            }
+            const double term_freq = ReadBinary<double>(in);
+            word_freqs[word] = term_freq;
+            search_server.word_to_document_freqs_[word][document_id] = term_freq;
+            if (options.impact_ordered_postings) {
+                search_server.word_to_document_impacts_[word].emplace(term_freq, document_id);
+            }
+            if (options.positional_index) {
+                PositionList& positions = search_server.word_to_document_positions_[word][document_id];
+                const std::uint32_t position_count = ReadBinary<std::uint32_t>(in);
+                for (std::uint32_t k = 0; k < position_count; ++k) {
+                    positions.Append(ReadBinary<std::uint32_t>(in));
+                }
+            }
+        }
+        search_server.documents_.emplace(document_id, DocumentData{ rating, status });
+        search_server.document_ids_.insert(document_id);
+    }
+    return search_server;
+}
+
+const std::pmr::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+    static const std::pmr::map<std::string_view, double> result;
     
     auto it = document_to_word_freqs_.find(document_id);
     if (it != document_to_word_freqs_.end())
@@ -236,7 +824,9 @@ void SearchServer::RemoveDocument(int document_id) {
         return;
     document_ids_.erase(pos_to_remove);
     documents_.erase(document_id);
-    for (auto& [word,_] : document_to_word_freqs_.at(document_id)) {
+    RemoveDocumentPositions(document_id);
+    RemoveDocumentImpacts(document_id);
+    for (auto& [word,_] : GetWordFrequencies(document_id)) {
         word_to_document_freqs_[word].erase(document_id);
     }
     document_to_word_freqs_.erase(document_id);
@@ -251,7 +841,7 @@ void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int do
         return;
     }
 
-    const std::map<std::string_view, double>& m = GetWordFrequencies(document_id);
+    const auto& m = GetWordFrequencies(document_id);
     std::vector<std::string_view> v(m.size());
     std::transform(policy, m.begin(), m.end(), v.begin(),
         [](auto& p) { return p.first; });
@@ -259,8 +849,34 @@ void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int do
         [this, document_id](auto& word)
         { word_to_document_freqs_[word].erase(document_id); }
     );
+    RemoveDocumentPositions(document_id);
+    RemoveDocumentImpacts(document_id);
 
     document_ids_.erase(document_id);
     documents_.erase(document_id);
     document_to_word_freqs_.erase(document_id);
-}
\ No newline at end of file
+}
+
+void SearchServer::RemoveDocumentPositions(int document_id) {
+    if (!options_.positional_index) {
+        return;
+    }
+    for (const auto& [word, _] : GetWordFrequencies(document_id)) {
+        auto it = word_to_document_positions_.find(word);
+        if (it != word_to_document_positions_.end()) {
+            it->second.erase(document_id);
+        }
+    }
+}
+
+void SearchServer::RemoveDocumentImpacts(int document_id) {
+    if (!options_.impact_ordered_postings) {
+        return;
+    }
+    for (const auto& [word, term_freq] : GetWordFrequencies(document_id)) {
+        auto it = word_to_document_impacts_.find(word);
+        if (it != word_to_document_impacts_.end()) {
+            it->second.erase({ term_freq, document_id });
+        }
+    }
+}
@@ -3,8 +3,15 @@
 #include "string_processing.h"
 #include "document.h"
 #include "concurrent_map.h"
+#include "counting_memory_resource.h"
+#include "instrumentation.h"
+#include "positional_index.h"
+#include "query_arena.h"
+#include "text_normalizer.h"
+#include "typo_index.h"
 
 #include <string>
+#include <deque>
 #include <iostream>
 #include <vector>
 #include <set>
@@ -12,11 +19,16 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <limits>
 #include <execution>
+#include <memory>
+#include <memory_resource>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
 const int BUCKET_COUNT = 100;
+const size_t MAX_TERM_EXPANSION_COUNT = 64;
+const size_t MAX_TERM_EXPANSION_SCAN = 10000;
 
 enum class DocumentStatus {
     ACTUAL,
@@ -25,18 +37,136 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Collection-wide counts needed for IDF. Shards of one collection merge their statistics
+// so that every shard ranks with the same IDF as a single server holding all documents.
+struct TermStatistics {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> document_freqs;
+
+    void Merge(const TermStatistics& other);
+};
+
+struct SearchServerOptions {
+    // Keeps word positions of every document to serve "quoted phrase" queries.
+    bool positional_index = false;
+    // Where the index containers get their memory; it must outlive the server. Parallel
+    // RemoveDocument frees nodes from several threads at once, so the resource must be thread-safe,
+    // e.g. std::pmr::synchronized_pool_resource, not unsynchronized_pool_resource or a monotonic
+    // buffer. nullptr means the default resource. Queries allocate from a per-thread arena instead.
+    std::pmr::memory_resource* memory_resource = nullptr;
+    // Applied to every term of documents, queries and stop words after case folding.
+    TextNormalizer::Stemmer stemmer;
+    // Keeps a second copy of every posting list ordered by term frequency, so that queries asking
+    // for a few top documents read the highest-scoring postings first and stop early. About doubles
+    // the posting memory.
+    bool impact_ordered_postings = false;
+    // With impact-ordered postings, a query reads at most this many postings and returns the best
+    // documents found by then, which may miss some of the exact top. 0 means exact results.
+    size_t max_impact_postings = 0;
+    // Plus words missing from the index are matched to indexed terms with up to this many typos,
+    // at most 2. Words under MIN_ONE_TYPO_WORD_LENGTH letters are taken as typed and words under
+    // MIN_TWO_TYPO_WORD_LENGTH get one typo. 0 disables it; otherwise every term's deletion
+    // variants are indexed, see TypoIndex.
+    size_t max_typo_edits = 0;
+    // Terms one misspelled word expands to: fewest typos first, then those in most documents.
+    size_t max_typo_expansions = 3;
+    // The relevance a corrected term adds is multiplied by this once per typo.
+    double typo_weight = 0.5;
+};
+
+// Words of one document in order, stop words removed. Words the normalizer left unchanged point
+// into the document text, the others into normalized_words, so the text must outlive the words.
+struct TokenizedDocument {
+    std::vector<std::string_view> words;
+    // Deque elements never move, so views into them stay valid.
+    std::deque<std::string> normalized_words;
+};
+
+struct IndexStructureMemory {
+    size_t bytes = 0;
+    size_t allocation_count = 0;
+};
+
+struct SearchServerStats {
+    size_t document_count = 0;
+    // Words present in at least one document.
+    size_t term_count = 0;
+    // (word, document) pairs over all terms.
+    size_t posting_count = 0;
+
+    // Exact heap usage of each index structure, nested containers and strings included.
+    IndexStructureMemory words;
+    IndexStructureMemory word_to_document_freqs;
+    IndexStructureMemory document_to_word_freqs;
+    IndexStructureMemory documents;
+    IndexStructureMemory document_ids;
+    IndexStructureMemory positions;
+    IndexStructureMemory impacts;
+    IndexStructureMemory typos;
+    size_t total_bytes = 0;
+
+    // posting_length_histogram[i] counts the terms whose posting list length lies in [2^i, 2^(i+1)).
+    std::vector<size_t> posting_length_histogram;
+    // Terms with the longest posting lists, longest first.
+    std::vector<std::pair<std::string, size_t>> largest_terms;
+};
+
+// How FindTopDocuments evaluates a query, see SearchServer::ExplainQuery.
+enum class QueryEvaluation {
+    // No plus word, or some phrase word, is in the index: nothing can match and no posting is read.
+    EMPTY,
+    // Posting lists are added one after another into per-document accumulators. Suits many terms.
+    TERM_AT_A_TIME,
+    // Posting lists are merged in document id order and every document is scored once, without
+    // accumulators. Suits a few terms.
+    DOCUMENT_AT_A_TIME,
+    // Impact-ordered posting lists are read highest term frequency first until no unread document
+    // can enter the top results, see SearchServerOptions::impact_ordered_postings.
+    IMPACT_ORDERED,
+};
+
+std::string_view GetQueryEvaluationName(QueryEvaluation evaluation);
+
+struct PlannedTerm {
+    std::string word;
+    size_t posting_count = 0;
+    // Below 1 for a correction of a misspelled query word.
+    double weight = 1.0;
+};
+
+struct QueryPlan {
+    QueryEvaluation evaluation = QueryEvaluation::EMPTY;
+    // Terms found in the index, in evaluation order: shortest posting list first.
+    std::vector<PlannedTerm> plus_terms;
+    std::vector<PlannedTerm> minus_terms;
+    // Normalized query terms that are not in the index. Misspelled words are listed here, their
+    // corrections among plus_terms.
+    std::vector<std::string> missing_terms;
+    size_t phrase_count = 0;
+    // Estimated ordered-map steps of each evaluation; the cheaper one is chosen.
+    double term_at_a_time_cost = 0;
+    double document_at_a_time_cost = 0;
+};
+
 class SearchServer {
 public:
 
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, const SearchServerOptions& options = {});
 
-    explicit SearchServer(const std::string& stop_words_text);
+    explicit SearchServer(const std::string& stop_words_text, const SearchServerOptions& options = {});
 
-    explicit SearchServer(const std::string_view stop_words_text);
+    explicit SearchServer(const std::string_view stop_words_text, const SearchServerOptions& options = {});
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Splits a document into indexable words exactly as AddDocument does. Only reads the stop words,
+    // so loaders may tokenize on other threads while AddTokenizedDocument runs.
+    TokenizedDocument TokenizeDocument(const std::string_view document) const;
+
+    // Indexes a document split by TokenizeDocument. The words only need to live until the call returns.
+    void AddTokenizedDocument(int document_id, const TokenizedDocument& document, DocumentStatus status, const std::vector<int>& ratings);
+
     template <typename Predicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate document_predicate) const;
 
@@ -53,11 +183,50 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query) const;
 
+    // Returns at most limit documents starting at position offset of the ranked result list.
+    // Only the top offset + limit matches are ordered, the rest are never sorted.
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t offset, size_t limit) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const;
+
+    // Same as FindTopDocuments, but also returns per-phase timings and counters of the query.
+    // The trace is all zeros unless the library is built with SEARCH_SERVER_INSTRUMENTATION.
+    template <typename ExecutionPolicy, typename Predicate>
+    std::pair<std::vector<Document>, QueryTrace> FindTopDocumentsTraced(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    std::pair<std::vector<Document>, QueryTrace> FindTopDocumentsTraced(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const;
+
+    std::pair<std::vector<Document>, QueryTrace> FindTopDocumentsTraced(const std::string_view raw_query) const;
+
+    // Document count and document frequencies of the query's plus terms in this server.
+    TermStatistics CollectTermStatistics(const std::string_view raw_query) const;
+
+    // The plan FindTopDocuments follows for the query when asked for MAX_RESULT_DOCUMENT_COUNT
+    // documents. The parallel policy always evaluates term at a time, since its accumulators are
+    // shared between threads.
+    QueryPlan ExplainQuery(const std::string_view raw_query) const;
+
+    // Ranks with the given collection-wide statistics instead of this server's own.
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, const TermStatistics& statistics, size_t limit) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const;
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
     int GetDocumentCount() const;
 
-    std::set<int>::const_iterator begin() const;
+    bool HasDocument(int document_id) const;
+
+    std::pmr::set<int>::const_iterator begin() const;
 
-    std::set<int>::const_iterator end() const;
+    std::pmr::set<int>::const_iterator end() const;
 
     std::pair<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
 
@@ -65,7 +234,7 @@ public:
 
     std::pair<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const;
  
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const std::pmr::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
 
@@ -73,65 +242,239 @@ public:
 
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
 
+    // Bytes taken by position lists, zero unless the positional index is enabled.
+    size_t GetPositionalIndexMemoryUsage() const;
+
+    // Memory figures are kept up to date by the allocators and cost nothing to read; the rest takes
+    // one pass over the terms, not over the postings.
+    SearchServerStats GetStats(size_t largest_term_count = 10) const;
+
+    // Binary image of the index together with its normalized stop words and options.
+    void WriteSnapshot(std::ostream& out) const;
+
+    // Throws std::runtime_error when the data is not a complete snapshot. The snapshot decides
+    // positional_index; memory_resource, stemmer, the impact-ordered postings and typo correction
+    // are taken from options, and the stemmer must be the one the index was built with.
+    static SearchServer ReadSnapshot(std::istream& in, const SearchServerOptions& options = {});
+
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
     };
 
-    std::set<std::string, std::less<>> words_;
+    // One counter per index structure. Kept on the heap so that the containers, which point to
+    // their resources, stay valid when the server is moved.
+    struct IndexMemory {
+        explicit IndexMemory(std::pmr::memory_resource* upstream);
+
+        CountingMemoryResource words;
+        CountingMemoryResource word_to_document_freqs;
+        CountingMemoryResource document_to_word_freqs;
+        CountingMemoryResource documents;
+        CountingMemoryResource document_ids;
+        CountingMemoryResource positions;
+        CountingMemoryResource impacts;
+        CountingMemoryResource typos;
+    };
+
+    const SearchServerOptions options_;
+
+    const TextNormalizer normalizer_{ options_.stemmer };
+
+    std::unique_ptr<IndexMemory> memory_ = std::make_unique<IndexMemory>(options_.memory_resource);
+
+    std::pmr::set<std::pmr::string, std::less<>> words_{ &memory_->words };
 
     const std::set<std::string, std::less<>> stop_words_;
 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    std::pmr::map<std::string_view, std::pmr::map<int, double>> word_to_document_freqs_{ &memory_->word_to_document_freqs };
+    std::pmr::map<int, std::pmr::map<std::string_view, double>> document_to_word_freqs_{ &memory_->document_to_word_freqs };
+    std::pmr::map<int, DocumentData> documents_{ &memory_->documents };
+    std::pmr::set<int> document_ids_{ &memory_->document_ids };
+    std::pmr::map<std::string_view, std::pmr::map<int, PositionList>> word_to_document_positions_{ &memory_->positions };
+    // (term frequency, document id) pairs of each word, highest frequency first.
+    using ImpactList = std::pmr::set<std::pair<double, int>, std::greater<>>;
+    std::pmr::map<std::string_view, ImpactList> word_to_document_impacts_{ &memory_->impacts };
+    // Deletion variants of words_, empty unless typos are corrected.
+    TypoIndex typo_index_{ options_.max_typo_edits, &memory_->typos };
 
-    bool IsStopWord(const std::string_view word) const;
+    // Stop words that already went through the normalizer, as stored in a snapshot.
+    SearchServer(const SearchServerOptions& options, std::set<std::string, std::less<>> normalized_stop_words);
 
-    static bool IsValidWord(const std::string_view word);
+    template <typename StringContainer>
+    std::set<std::string, std::less<>> NormalizeStopWords(const StringContainer& stop_words) const;
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    bool IsStopWord(const std::string_view word) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // A query word with its minus sign removed, before normalization.
     struct QueryWord {
         std::string_view data;
         bool is_minus;
-        bool is_stop;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Words that must follow each other in a document; slop allows extra words in between.
+    struct Phrase {
+        using allocator_type = std::pmr::polymorphic_allocator<std::string_view>;
+
+        explicit Phrase(const allocator_type& allocator)
+            : words(allocator) {
+        }
+
+        Phrase(const Phrase& other, const allocator_type& allocator)
+            : words(other.words, allocator)
+            , slop(other.slop) {
+        }
+
+        Phrase(Phrase&& other, const allocator_type& allocator)
+            : words(std::move(other.words), allocator)
+            , slop(other.slop) {
+        }
+
+        std::pmr::vector<std::string_view> words;
+        int slop = 0;
+    };
+
+    // Lives for one query, its containers take memory from the query arena.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource)
+            , minus_words(resource)
+            , phrases(resource)
+            , normalized_terms(resource)
+            , typo_weights(resource) {
+        }
+
+        // Views of normalized terms stay valid for the lifetime of the query.
+        std::string_view KeepTerm(std::string_view term, bool borrowed) {
+            return borrowed ? term : std::string_view(normalized_terms.emplace_back(term));
+        }
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<Phrase> phrases;
+        // Terms that differ from their spelling in the query text; deque elements never move.
+        std::pmr::deque<std::pmr::string> normalized_terms;
+        // Corrections of misspelled plus words with their weights, also kept in plus_words.
+        std::pmr::map<std::string_view, double> typo_weights;
+        // Collection-wide counts of a sharded query. Wildcard expansions and typo corrections are
+        // picked by these counts, so that every shard picks the same terms as a single server.
+        const TermStatistics* statistics = nullptr;
+        // Set when collecting statistics: every expansion and correction is kept, since which ones
+        // are the best is only known once the counts of all shards are merged.
+        bool keep_all_candidates = false;
+    };
+
+    // Indexed terms the pattern matches, at most MAX_TERM_EXPANSION_COUNT of them unless the query
+    // keeps all candidates. Allocates from the query arena.
+    std::pmr::vector<std::string_view> ExpandTermPattern(const std::string_view pattern, const Query& query) const;
+
+    // Adds the best indexed terms within the allowed typos of a plus word that is not in the index.
+    void AddTypoCorrections(const std::string_view word, Query& query) const;
+
+    void ParseQueryWords(const std::string_view text, Query& query) const;
+
+    // Normalized words are kept in the query.
+    Phrase ParsePhrase(const std::string_view text, Query& query) const;
+
+    void ParseQueryText(std::string_view text, Query& query) const;
+
+    // Moves the typo corrections into plus_words, except those the query also has as typed.
+    static void MergeTypoCorrections(Query& query);
+
+    Query ParseQuery(const std::string_view text, std::pmr::memory_resource* resource, const TermStatistics* statistics = nullptr) const;
+
+    Query ParseQuery(const std::execution::sequenced_policy& policy, const std::string_view text, std::pmr::memory_resource* resource, const TermStatistics* statistics = nullptr) const;
+
+    Query ParseQuery(const std::execution::parallel_policy& policy, const std::string_view text, std::pmr::memory_resource* resource) const;
+
+    double ComputeWordInverseDocumentFreq(const std::string_view word, const TermStatistics* statistics = nullptr) const;
+
+    // Posting list of the word, nullptr when no document has it.
+    const std::pmr::map<int, double>* FindPostings(const std::string_view word) const;
+
+    struct PlannedPostings {
+        std::string_view word;
+        const std::pmr::map<int, double>* postings;
+        // nullptr unless impact-ordered postings are kept.
+        const ImpactList* impacts;
+        double inverse_document_freq;
     };
 
-    Query ParseQuery(const std::string_view text) const;
+    // Query terms resolved against the index, shortest posting list first. Lives in the query's arena.
+    struct Plan {
+        explicit Plan(std::pmr::memory_resource* resource)
+            : plus_terms(resource)
+            , minus_terms(resource) {
+        }
 
-    Query ParseQuery(const std::execution::sequenced_policy& policy, const std::string_view text) const;
+        QueryEvaluation evaluation = QueryEvaluation::EMPTY;
+        // offset + limit of the request: how many top documents have to be exact.
+        size_t result_count = 0;
+        std::pmr::vector<PlannedPostings> plus_terms;
+        std::pmr::vector<PlannedPostings> minus_terms;
+        double term_at_a_time_cost = 0;
+        double document_at_a_time_cost = 0;
+    };
 
-    Query ParseQuery(const std::execution::parallel_policy& policy, const std::string_view text) const;
+    Plan PlanQuery(const Query& query, size_t result_count) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Drops accumulated documents that have a minus word. Shortest lists go first, and a list much
+    // longer than the remaining candidates is probed per candidate instead of being scanned.
+    template <typename DocumentToRelevance>
+    void ApplyMinusTerms(const Plan& plan, DocumentToRelevance& document_to_relevance, QueryTrace* trace) const;
 
+    size_t CountPostings(const std::pmr::vector<std::string_view>& words) const;
+
+    bool MatchesPhrases(const Query& query, int document_id) const;
+
+    void RemoveDocumentPositions(int document_id);
+
+    void RemoveDocumentImpacts(int document_id);
+
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t offset, size_t limit, const TermStatistics* statistics, QueryTrace* trace) const;
+
+    // Matches are allocated from the query's arena.
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, Predicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, const Plan& plan, Predicate document_predicate, QueryTrace* trace) const;
 
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, Predicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, const Plan& plan, Predicate document_predicate, QueryTrace* trace) const;
+
+    template <typename Predicate>
+    std::pmr::vector<Document> FindAllDocumentsByDocument(const Query& query, const Plan& plan, Predicate document_predicate, QueryTrace* trace) const;
+
+    // Threshold algorithm over the impact-ordered lists: takes the next posting of the term whose
+    // next score is highest and scores its document completely through the document-ordered lists.
+    // Unread documents score at most the sum of the next scores of all terms, so reading stops once
+    // that bound is below the current top by more than EPSILON, where ratings no longer decide.
+    // Returns at most plan.result_count documents.
+    template <typename Predicate>
+    std::pmr::vector<Document> FindTopDocumentsByImpact(const Query& query, const Plan& plan, Predicate document_predicate, QueryTrace* trace) const;
 
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer& stop_words, const SearchServerOptions& options)
+    : options_(options)
+    , stop_words_(NormalizeStopWords(stop_words))
 {
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-        throw std::invalid_argument("Some of stop words are invalid");
+}
+
+template <typename StringContainer>
+std::set<std::string, std::less<>> SearchServer::NormalizeStopWords(const StringContainer& stop_words) const {
+    std::set<std::string, std::less<>> normalized_stop_words;
+    for (const auto& stop_word : stop_words) {
+        normalizer_.ForEachTerm(stop_word, [&normalized_stop_words](std::string_view term, bool) {
+            normalized_stop_words.emplace(term);
+            });
     }
+    return normalized_stop_words;
 }
 
 template <typename Predicate>
@@ -141,26 +484,51 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, 0, MAX_RESULT_DOCUMENT_COUNT);
+}
 
-    const auto query = ParseQuery(std::execution::seq, raw_query);
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t offset, size_t limit) const {
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    QueryTrace trace;
+    auto result = FindTopDocuments(policy, raw_query, document_predicate, offset, limit, nullptr, &trace);
+    TRACE_RECORD(trace);
+    return result;
+#else
+    return FindTopDocuments(policy, raw_query, document_predicate, offset, limit, nullptr, nullptr);
+#endif
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t offset, size_t limit, const TermStatistics* statistics, [[maybe_unused]] QueryTrace* trace) const {
+    // Everything up to the returned window lives in the thread's arena and is dropped at once.
+    const QueryArenaScope arena;
+    Query query(arena.GetResource());
+    {
+        TRACE_PHASE(trace, QueryPhase::PARSE);
+        query = ParseQuery(std::execution::seq, raw_query, arena.GetResource(), statistics);
+    }
+    Plan plan(arena.GetResource());
+    {
+        TRACE_PHASE(trace, QueryPhase::PLAN);
+        plan = PlanQuery(query, offset + std::min(limit, std::numeric_limits<size_t>::max() - offset));
+    }
+    if (plan.evaluation == QueryEvaluation::EMPTY) {
+        return {};
+    }
 
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
+    auto matched_documents = FindAllDocuments(policy, query, plan, document_predicate, trace);
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    TRACE_PHASE(trace, QueryPhase::SORT_TOP_K);
+    if (offset >= matched_documents.size()) {
+        return {};
     }
 
-    return matched_documents;
+    // Only the requested window has to be ordered: partial_sort costs O(n log(offset + limit)).
+    const auto window_end = matched_documents.begin() + offset + std::min(limit, matched_documents.size() - offset);
+    std::partial_sort(matched_documents.begin(), window_end, matched_documents.end(), IsMoreRelevant);
+
+    return std::vector<Document>(matched_documents.begin() + offset, window_end);
 }
 
 template <typename ExecutionPolicy>
@@ -175,76 +543,325 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, Predicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const {
+    return FindTopDocuments(policy, raw_query, [status]([[maybe_unused]] int document_id, DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        }, offset, limit);
+}
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, const TermStatistics& statistics, size_t limit) const {
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    QueryTrace trace;
+    auto result = FindTopDocuments(policy, raw_query, document_predicate, 0, limit, &statistics, &trace);
+    TRACE_RECORD(trace);
+    return result;
+#else
+    return FindTopDocuments(policy, raw_query, document_predicate, 0, limit, &statistics, nullptr);
+#endif
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const {
+    return FindTopDocuments(policy, raw_query, [status]([[maybe_unused]] int document_id, DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        }, statistics, limit);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::pair<std::vector<Document>, QueryTrace> SearchServer::FindTopDocumentsTraced(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate) const {
+    QueryTrace trace;
+    auto result = FindTopDocuments(policy, raw_query, document_predicate, 0, MAX_RESULT_DOCUMENT_COUNT, nullptr, &trace);
+    TRACE_RECORD(trace);
+    return { std::move(result), trace };
+}
+
+template <typename ExecutionPolicy>
+std::pair<std::vector<Document>, QueryTrace> SearchServer::FindTopDocumentsTraced(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocumentsTraced(policy, raw_query, [status]([[maybe_unused]] int document_id, DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        });
+}
+
+template <typename DocumentToRelevance>
+void SearchServer::ApplyMinusTerms(const Plan& plan, DocumentToRelevance& document_to_relevance, [[maybe_unused]] QueryTrace* trace) const {
+    for (const PlannedPostings& term : plan.minus_terms) {
+        if (document_to_relevance.empty()) {
+            return;
+        }
+        const size_t posting_count = term.postings->size();
+        if (posting_count > document_to_relevance.size() * std::log2(posting_count + 1.0)) {
+            TRACE_COUNT(trace, postings_visited, document_to_relevance.size());
+            for (auto it = document_to_relevance.begin(); it != document_to_relevance.end();) {
+                it = term.postings->count(it->first) > 0 ? document_to_relevance.erase(it) : std::next(it);
+            }
+        }
+        else {
+            TRACE_COUNT(trace, postings_visited, posting_count);
+            for (const auto [document_id, _] : *term.postings) {
+                document_to_relevance.erase(document_id);
+            }
         }
+    }
+}
 
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+template <typename Predicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, const Plan& plan, Predicate document_predicate, [[maybe_unused]] QueryTrace* trace) const {
+    if (plan.evaluation == QueryEvaluation::DOCUMENT_AT_A_TIME) {
+        return FindAllDocumentsByDocument(query, plan, document_predicate, trace);
+    }
+    if (plan.evaluation == QueryEvaluation::IMPACT_ORDERED) {
+        return FindTopDocumentsByImpact(query, plan, document_predicate, trace);
+    }
 
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    std::pmr::map<int, double> document_to_relevance(resource);
+
+    {
+        TRACE_PHASE(trace, QueryPhase::POSTING_SCAN);
+        for (const PlannedPostings& term : plan.plus_terms) {
+            TRACE_COUNT(trace, postings_visited, term.postings->size());
+            for (const auto [document_id, term_freq] : *term.postings) {
+                const auto& document_data = documents_.at(document_id);
+                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                    document_to_relevance[document_id] += term_freq * term.inverse_document_freq;
+                }
             }
         }
+        TRACE_COUNT(trace, documents_scored, document_to_relevance.size());
     }
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    {
+        TRACE_PHASE(trace, QueryPhase::MINUS_FILTER);
+        ApplyMinusTerms(plan, document_to_relevance, trace);
+    }
+
+    std::pmr::vector<Document> matched_documents(resource);
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto [document_id, relevance] : document_to_relevance) {
+        if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
             continue;
         }
+        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    }
 
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+    return matched_documents;
+}
+
+template <typename Predicate>
+std::pmr::vector<Document> SearchServer::FindAllDocumentsByDocument(const Query& query, const Plan& plan, Predicate document_predicate, [[maybe_unused]] QueryTrace* trace) const {
+    using PostingIterator = std::pmr::map<int, double>::const_iterator;
+    struct Cursor {
+        PostingIterator position;
+        PostingIterator end;
+        double inverse_document_freq;
+    };
+
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    std::pmr::vector<Cursor> cursors(resource);
+    cursors.reserve(plan.plus_terms.size());
+    size_t candidate_estimate = 0;
+    for (const PlannedPostings& term : plan.plus_terms) {
+        cursors.push_back({ term.postings->begin(), term.postings->end(), term.inverse_document_freq });
+        candidate_estimate += term.postings->size();
+        TRACE_COUNT(trace, postings_visited, term.postings->size());
+    }
+    candidate_estimate = std::min(candidate_estimate, documents_.size());
+
+    // Minus lists are walked alongside in document order; one far longer than the candidates is
+    // probed per document instead.
+    std::pmr::vector<Cursor> minus_cursors(resource);
+    std::pmr::vector<const std::pmr::map<int, double>*> minus_probes(resource);
+    for (const PlannedPostings& term : plan.minus_terms) {
+        const size_t posting_count = term.postings->size();
+        if (posting_count > candidate_estimate * std::log2(posting_count + 1.0)) {
+            minus_probes.push_back(term.postings);
+        }
+        else {
+            minus_cursors.push_back({ term.postings->begin(), term.postings->end(), 0.0 });
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    std::pmr::vector<Document> matched_documents(resource);
+    TRACE_PHASE(trace, QueryPhase::POSTING_SCAN);
+    while (true) {
+        int document_id = std::numeric_limits<int>::max();
+        bool has_postings = false;
+        for (const Cursor& cursor : cursors) {
+            if (cursor.position != cursor.end && cursor.position->first <= document_id) {
+                document_id = cursor.position->first;
+                has_postings = true;
+            }
+        }
+        if (!has_postings) {
+            break;
+        }
+
+        double relevance = 0.0;
+        for (Cursor& cursor : cursors) {
+            if (cursor.position != cursor.end && cursor.position->first == document_id) {
+                relevance += cursor.position->second * cursor.inverse_document_freq;
+                ++cursor.position;
+            }
+        }
+
+        bool is_excluded = false;
+        for (Cursor& cursor : minus_cursors) {
+            while (cursor.position != cursor.end && cursor.position->first < document_id) {
+                ++cursor.position;
+            }
+            if (cursor.position != cursor.end && cursor.position->first == document_id) {
+                is_excluded = true;
+                break;
+            }
+        }
+        is_excluded = is_excluded || std::any_of(minus_probes.begin(), minus_probes.end(),
+            [document_id](const auto* postings) { return postings->count(document_id) > 0; });
+        if (is_excluded) {
+            continue;
+        }
+
+        const auto& document_data = documents_.at(document_id);
+        if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+            continue;
+        }
+        TRACE_COUNT(trace, documents_scored, 1);
+        if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
+            continue;
+        }
+        matched_documents.push_back({ document_id, relevance, document_data.rating });
     }
 
     return matched_documents;
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, Predicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
+std::pmr::vector<Document> SearchServer::FindTopDocumentsByImpact(const Query& query, const Plan& plan, Predicate document_predicate, [[maybe_unused]] QueryTrace* trace) const {
+    using ImpactIterator = ImpactList::const_iterator;
+    struct Cursor {
+        ImpactIterator position;
+        ImpactIterator end;
+        double inverse_document_freq;
+
+        double GetNextScore() const {
+            return position == end ? 0.0 : position->first * inverse_document_freq;
+        }
+    };
 
-    for_each(std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, &document_to_relevance, &document_predicate](const auto& word) {
-            if (word_to_document_freqs_.count(word)) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+    std::pmr::memory_resource* const resource = query.plus_words.get_allocator().resource();
+    std::pmr::vector<Cursor> cursors(resource);
+    cursors.reserve(plan.plus_terms.size());
+    for (const PlannedPostings& term : plan.plus_terms) {
+        cursors.push_back({ term.impacts->begin(), term.impacts->end(), term.inverse_document_freq });
+    }
 
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
+    // Heap of the best documents so far, the least relevant one on top.
+    std::pmr::vector<Document> top_documents(resource);
+    top_documents.reserve(plan.result_count + 1);
+    std::pmr::set<int> seen_documents(resource);
+    const size_t max_postings = options_.max_impact_postings;
+    size_t postings_read = 0;
+
+    TRACE_PHASE(trace, QueryPhase::POSTING_SCAN);
+    while (max_postings == 0 || postings_read < max_postings) {
+        Cursor* next = nullptr;
+        double threshold = 0.0;
+        for (Cursor& cursor : cursors) {
+            const double score = cursor.GetNextScore();
+            threshold += score;
+            if (cursor.position != cursor.end && (next == nullptr || score > next->GetNextScore())) {
+                next = &cursor;
             }
-        });
+        }
+        if (next == nullptr) {
+            break;
+        }
+        if (top_documents.size() == plan.result_count && top_documents.front().relevance - threshold > 2 * EPSILON) {
+            break;
+        }
 
-    std::map<int, double> document_to_relevance_ordinary = document_to_relevance.BuildOrdinaryMap();
+        const int document_id = next->position->second;
+        ++next->position;
+        ++postings_read;
+        if (!seen_documents.insert(document_id).second) {
+            continue;
+        }
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto& document_data = documents_.at(document_id);
+        if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+            continue;
+        }
+        const bool is_excluded = std::any_of(plan.minus_terms.begin(), plan.minus_terms.end(),
+            [document_id](const PlannedPostings& term) { return term.postings->count(document_id) > 0; });
+        if (is_excluded) {
             continue;
         }
 
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance_ordinary.erase(document_id);
+        // Summed in plan order, as the other evaluations do, so relevance is the same to the bit.
+        double relevance = 0.0;
+        for (const PlannedPostings& term : plan.plus_terms) {
+            const auto it = term.postings->find(document_id);
+            if (it != term.postings->end()) {
+                relevance += it->second * term.inverse_document_freq;
+            }
+        }
+        TRACE_COUNT(trace, documents_scored, 1);
+
+        const Document document{ document_id, relevance, document_data.rating };
+        if (top_documents.size() == plan.result_count && !IsMoreRelevant(document, top_documents.front())) {
+            continue;
+        }
+        if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
+            continue;
+        }
+        top_documents.push_back(document);
+        std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        if (top_documents.size() > plan.result_count) {
+            std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            top_documents.pop_back();
         }
     }
+    TRACE_COUNT(trace, postings_visited, postings_read);
 
-    std::vector<Document> matched_documents;
+    return top_documents;
+}
+
+template <typename Predicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, const Plan& plan, Predicate document_predicate, [[maybe_unused]] QueryTrace* trace) const {
+    // Filled from pool threads, so it cannot use the calling thread's arena.
+    ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
+    std::map<int, double> document_to_relevance_ordinary;
+
+    {
+        TRACE_PHASE(trace, QueryPhase::POSTING_SCAN);
+        for_each(std::execution::par,
+            plan.plus_terms.begin(), plan.plus_terms.end(),
+            [this, &document_to_relevance, &document_predicate](const PlannedPostings& term) {
+                for (const auto [document_id, term_freq] : *term.postings) {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance[document_id].ref_to_value += term_freq * term.inverse_document_freq;
+                    }
+                }
+            });
+
+        document_to_relevance_ordinary = document_to_relevance.BuildOrdinaryMap();
+        TRACE_COUNT(trace, postings_visited, CountPostings(query.plus_words));
+        TRACE_COUNT(trace, documents_scored, document_to_relevance_ordinary.size());
+    }
+
+    {
+        TRACE_PHASE(trace, QueryPhase::MINUS_FILTER);
+        ApplyMinusTerms(plan, document_to_relevance_ordinary, trace);
+    }
+
+    std::pmr::vector<Document> matched_documents(query.plus_words.get_allocator().resource());
+    matched_documents.reserve(document_to_relevance_ordinary.size());
     for (const auto [document_id, relevance] : document_to_relevance_ordinary) {
+        if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
+            continue;
+        }
         matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
 
@@ -0,0 +1,38 @@
+#include "search_server.h"
+#include "shard_transport.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Usage: search_shard <socket path> [stop words]
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: search_shard <socket path> [\"stop words\"]"s << endl;
+        return 2;
+    }
+
+    // Signals are taken by a dedicated thread, so stopping does not run inside a signal handler.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    SearchServer search_server(argc == 3 ? string(argv[2]) : ""s);
+    ShardServer shard_server(search_server, argv[1]);
+
+    thread([&shard_server, signals] {
+        int signal_number = 0;
+        sigwait(&signals, &signal_number);
+        shard_server.Stop();
+    }).detach();
+
+    shard_server.Run();
+    return 0;
+}
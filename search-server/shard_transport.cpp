@@ -0,0 +1,228 @@
+#include "shard_transport.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+namespace {
+
+void CheckProtocolText(const std::string_view text) {
+    if (text.find_first_of("\t\n") != text.npos) {
+        throw std::invalid_argument("Some words have invalid symbols");
+    }
+}
+
+void AppendStatistics(std::string& out, const TermStatistics& statistics) {
+    out += std::to_string(statistics.document_count);
+    for (const auto& [word, document_freq] : statistics.document_freqs) {
+        out += '\t';
+        out += word;
+        out += '\t';
+        out += std::to_string(document_freq);
+    }
+}
+
+template <typename Field>
+TermStatistics ParseStatistics(const std::vector<Field>& fields, size_t first) {
+    if (fields.size() <= first || (fields.size() - first) % 2 != 1) {
+        throw std::runtime_error("Malformed term statistics");
+    }
+    TermStatistics statistics;
+    statistics.document_count = std::stoi(std::string(fields[first]));
+    for (size_t i = first + 1; i + 1 < fields.size(); i += 2) {
+        statistics.document_freqs.emplace(std::string(fields[i]), std::stoi(std::string(fields[i + 1])));
+    }
+    return statistics;
+}
+
+}  // namespace
+
+RemoteShard::RemoteShard(const std::string& socket_path)
+    : connection_(ConnectUnixSocket(socket_path)) {
+}
+
+std::vector<std::string> RemoteShard::Request(const std::string& request) const {
+    std::string answer;
+    {
+        std::lock_guard guard(mutex_);
+        connection_.WriteAll(request + '\n');
+        if (!connection_.ReadLine(answer)) {
+            throw std::runtime_error("Shard closed the connection");
+        }
+    }
+
+    std::vector<std::string> fields;
+    for (const auto field : SplitIntoFields(answer, '\t')) {
+        fields.emplace_back(field);
+    }
+    if (fields[0] == "OK") {
+        fields.erase(fields.begin());
+        return fields;
+    }
+    ThrowRemoteError(answer);
+}
+
+void RemoteShard::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    CheckProtocolText(document);
+    std::string request = "ADD\t" + std::to_string(document_id) + '\t' + std::to_string(static_cast<int>(status)) + '\t';
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        if (i > 0) {
+            request += ',';
+        }
+        request += std::to_string(ratings[i]);
+    }
+    request += '\t';
+    request += document;
+    Request(request);
+}
+
+void RemoteShard::RemoveDocument(int document_id) {
+    Request("REMOVE\t" + std::to_string(document_id));
+}
+
+int RemoteShard::GetDocumentCount() const {
+    return std::stoi(Request("COUNT").at(0));
+}
+
+TermStatistics RemoteShard::CollectTermStatistics(const std::string_view raw_query) const {
+    CheckProtocolText(raw_query);
+    return ParseStatistics(Request("STATS\t" + std::string(raw_query)), 0);
+}
+
+std::vector<Document> RemoteShard::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const {
+    CheckProtocolText(raw_query);
+    std::string request = "FIND\t" + std::to_string(static_cast<int>(status)) + '\t' + std::to_string(limit) + '\t';
+    request += raw_query;
+    request += '\t';
+    AppendStatistics(request, statistics);
+
+    const auto fields = Request(request);
+    if (fields.size() % 3 != 0) {
+        throw std::runtime_error("Malformed shard answer");
+    }
+    std::vector<Document> documents;
+    for (size_t i = 0; i < fields.size(); i += 3) {
+        documents.emplace_back(std::stoi(fields[i]), std::stod(fields[i + 1]), std::stoi(fields[i + 2]));
+    }
+    return documents;
+}
+
+ShardServer::ShardServer(SearchServer& search_server, const std::string& socket_path)
+    : search_server_(search_server)
+    , socket_path_(socket_path)
+    , listen_descriptor_(ListenUnixSocket(socket_path)) {
+}
+
+ShardServer::~ShardServer() {
+    Stop();
+    for (auto& [number, worker] : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    close(listen_descriptor_);
+    unlink(socket_path_.c_str());
+}
+
+void ShardServer::Run() {
+    while (!stopping_) {
+        const int descriptor = accept(listen_descriptor_, nullptr, nullptr);
+        if (descriptor < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        std::lock_guard guard(connections_mutex_);
+        if (stopping_) {
+            close(descriptor);
+            break;
+        }
+        ReapFinishedWorkers();
+        connection_descriptors_.insert(descriptor);
+        const size_t worker = next_worker_++;
+        workers_.emplace(worker, std::thread([this, descriptor, worker] { ServeConnection(descriptor, worker); }));
+    }
+}
+
+void ShardServer::Stop() {
+    stopping_ = true;
+    shutdown(listen_descriptor_, SHUT_RDWR);
+    std::lock_guard guard(connections_mutex_);
+    for (const int descriptor : connection_descriptors_) {
+        shutdown(descriptor, SHUT_RDWR);
+    }
+}
+
+void ShardServer::ReapFinishedWorkers() {
+    for (const size_t worker : finished_workers_) {
+        // The thread only has to return after releasing connections_mutex_.
+        const auto it = workers_.find(worker);
+        it->second.join();
+        workers_.erase(it);
+    }
+    finished_workers_.clear();
+}
+
+void ShardServer::ServeConnection(int descriptor, size_t worker) {
+    LineConnection connection(descriptor);
+    std::string request;
+    try {
+        while (connection.ReadLine(request)) {
+            connection.WriteAll(HandleRequest(request) + '\n');
+        }
+    }
+    catch (const std::exception&) {
+        // The peer went away while we were answering, nothing left to do for this connection.
+    }
+    std::lock_guard guard(connections_mutex_);
+    connection_descriptors_.erase(descriptor);
+    finished_workers_.push_back(worker);
+}
+
+std::string ShardServer::HandleRequest(const std::string& request) {
+    return AnswerRequest([this, &request] {
+        const auto fields = SplitIntoFields(request, '\t');
+        const std::string_view command = fields[0];
+        std::string answer = "OK";
+
+        if (command == "ADD" && fields.size() == 5) {
+            std::vector<int> ratings;
+            if (!fields[3].empty()) {
+                for (const auto rating : SplitIntoFields(fields[3], ',')) {
+                    ratings.push_back(std::stoi(std::string(rating)));
+                }
+            }
+            std::unique_lock lock(server_mutex_);
+            search_server_.AddDocument(std::stoi(std::string(fields[1])), fields[4],
+                static_cast<DocumentStatus>(std::stoi(std::string(fields[2]))), ratings);
+        }
+        else if (command == "REMOVE" && fields.size() == 2) {
+            std::unique_lock lock(server_mutex_);
+            search_server_.RemoveDocument(std::stoi(std::string(fields[1])));
+        }
+        else if (command == "COUNT" && fields.size() == 1) {
+            std::shared_lock lock(server_mutex_);
+            answer += '\t' + std::to_string(search_server_.GetDocumentCount());
+        }
+        else if (command == "STATS" && fields.size() == 2) {
+            std::shared_lock lock(server_mutex_);
+            answer += '\t';
+            AppendStatistics(answer, search_server_.CollectTermStatistics(fields[1]));
+        }
+        else if (command == "FIND" && fields.size() >= 5) {
+            const auto status = static_cast<DocumentStatus>(std::stoi(std::string(fields[1])));
+            const size_t limit = std::stoul(std::string(fields[2]));
+            const TermStatistics statistics = ParseStatistics(fields, 4);
+            std::shared_lock lock(server_mutex_);
+            for (const Document& document : search_server_.FindTopDocuments(std::execution::seq, fields[3], status, statistics, limit)) {
+                answer += '\t' + std::to_string(document.id) + '\t' + FormatRelevance(document.relevance) + '\t' + std::to_string(document.rating);
+            }
+        }
+        else {
+            throw std::runtime_error("Unknown request");
+        }
+        return answer;
+    });
+}
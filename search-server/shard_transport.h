@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sharded_search_server.h"
+#include "socket_io.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Line protocol between a coordinator and a shard process, fields separated by '\t':
+//   ADD <id> <status> <comma-separated ratings> <text>   -> OK
+//   REMOVE <id>                                         -> OK
+//   COUNT                                               -> OK <document count>
+//   STATS <query>                                       -> OK <document count> (<term> <freq>)*
+//   FIND <status> <limit> <query> <document count> (<term> <freq>)*
+//                                                       -> OK (<id> <relevance> <rating>)*
+// Failures are answered with ERR <exception kind> <message> and rethrown by the client.
+
+class RemoteShard : public SearchShard {
+public:
+    explicit RemoteShard(const std::string& socket_path);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+
+    void RemoveDocument(int document_id) override;
+
+    int GetDocumentCount() const override;
+
+    TermStatistics CollectTermStatistics(const std::string_view raw_query) const override;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const override;
+
+private:
+    mutable std::mutex mutex_;
+    mutable LineConnection connection_;
+
+    // Sends one request line and returns the fields of the answer after "OK".
+    std::vector<std::string> Request(const std::string& request) const;
+};
+
+// Serves one SearchServer over a Unix socket. Queries run concurrently,
+// AddDocument and RemoveDocument take the server exclusively.
+class ShardServer {
+public:
+    ShardServer(SearchServer& search_server, const std::string& socket_path);
+
+    ~ShardServer();
+
+    // Accepts connections until Stop is called.
+    void Run();
+
+    void Stop();
+
+private:
+    SearchServer& search_server_;
+    const std::string socket_path_;
+    const int listen_descriptor_;
+    std::atomic<bool> stopping_ = false;
+    std::shared_mutex server_mutex_;
+    std::mutex connections_mutex_;
+    std::set<int> connection_descriptors_;
+    // One thread per open connection by a sequence number; threads that are done list their
+    // number in finished_workers_ and Run joins them at the next connection.
+    std::map<size_t, std::thread> workers_;
+    std::vector<size_t> finished_workers_;
+    size_t next_worker_ = 0;
+
+    void ServeConnection(int descriptor, size_t worker);
+
+    // Joins the threads of closed connections. Expects connections_mutex_ to be held.
+    void ReapFinishedWorkers();
+
+    std::string HandleRequest(const std::string& request);
+};
@@ -0,0 +1,124 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+
+LocalShard::LocalShard(const std::string& stop_words_text, const SearchServerOptions& options)
+    : server_(stop_words_text, options) {
+}
+
+void LocalShard::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    server_.AddDocument(document_id, document, status, ratings);
+}
+
+void LocalShard::RemoveDocument(int document_id) {
+    server_.RemoveDocument(document_id);
+}
+
+int LocalShard::GetDocumentCount() const {
+    return server_.GetDocumentCount();
+}
+
+TermStatistics LocalShard::CollectTermStatistics(const std::string_view raw_query) const {
+    return server_.CollectTermStatistics(raw_query);
+}
+
+std::vector<Document> LocalShard::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const {
+    return server_.FindTopDocuments(std::execution::seq, raw_query, status, statistics, limit);
+}
+
+ShardedSearchServer::ShardedSearchServer(std::vector<std::unique_ptr<SearchShard>> shards)
+    : shards_(std::move(shards)) {
+    if (shards_.empty()) {
+        throw std::invalid_argument("A sharded server needs at least one shard");
+    }
+}
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count, const SearchServerOptions& options) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("A sharded server needs at least one shard");
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<LocalShard>(stop_words_text, options));
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)]->AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)]->RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Result, typename Function>
+std::vector<Result> ShardedSearchServer::ForEachShard(Function function) const {
+    std::vector<Result> results(shards_.size());
+    std::vector<std::exception_ptr> errors(shards_.size());
+    // Parallel algorithms terminate on exceptions, so shard errors are carried out by hand.
+    std::vector<size_t> indexes(shards_.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+        [this, &function, &results, &errors](size_t index) {
+            try {
+                results[index] = function(*shards_[index]);
+            }
+            catch (...) {
+                errors[index] = std::current_exception();
+            }
+        });
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+    const auto shard_statistics = ForEachShard<TermStatistics>(
+        [raw_query](const SearchShard& shard) { return shard.CollectTermStatistics(raw_query); });
+
+    TermStatistics statistics;
+    for (const auto& shard_statistic : shard_statistics) {
+        statistics.Merge(shard_statistic);
+    }
+
+    // Every shard returns its own top-K: the global top-K is always among them.
+    auto shard_results = ForEachShard<std::vector<Document>>(
+        [raw_query, status, &statistics](const SearchShard& shard) {
+            return shard.FindTopDocuments(raw_query, status, statistics, MAX_RESULT_DOCUMENT_COUNT);
+        });
+
+    std::vector<Document> matched_documents;
+    for (auto& documents : shard_results) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), SearchServer::IsMoreRelevant);
+    matched_documents.erase(top_end, matched_documents.end());
+    return matched_documents;
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return std::accumulate(shards_.begin(), shards_.end(), 0,
+        [](int count, const auto& shard) { return count + shard->GetDocumentCount(); });
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Fibonacci hashing spreads sequential ids evenly across shards.
+    const std::uint64_t hash = static_cast<std::uint64_t>(static_cast<std::uint32_t>(document_id)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>((hash >> 32) % shards_.size());
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// One partition of a sharded collection: an in-process SearchServer or a remote process.
+class SearchShard {
+public:
+    virtual ~SearchShard() = default;
+
+    virtual void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) = 0;
+
+    virtual void RemoveDocument(int document_id) = 0;
+
+    virtual int GetDocumentCount() const = 0;
+
+    virtual TermStatistics CollectTermStatistics(const std::string_view raw_query) const = 0;
+
+    virtual std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const = 0;
+};
+
+class LocalShard : public SearchShard {
+public:
+    explicit LocalShard(const std::string& stop_words_text, const SearchServerOptions& options = {});
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+
+    void RemoveDocument(int document_id) override;
+
+    int GetDocumentCount() const override;
+
+    TermStatistics CollectTermStatistics(const std::string_view raw_query) const override;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const TermStatistics& statistics, size_t limit) const override;
+
+private:
+    SearchServer server_;
+};
+
+// Scatter-gather coordinator. Documents are partitioned by a hash of their id; a query first
+// gathers document frequencies from every shard, then every shard ranks with the merged
+// statistics, so relevances are the same as in a single SearchServer holding all documents.
+// Wildcard expansions and typo corrections are picked by the merged statistics as well: the
+// statistics list every candidate of every shard, so no shard settles for its local best.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(std::vector<std::unique_ptr<SearchShard>> shards);
+
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count, const SearchServerOptions& options = {});
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+    size_t GetShardIndex(int document_id) const;
+
+private:
+    std::vector<std::unique_ptr<SearchShard>> shards_;
+
+    template <typename Result, typename Function>
+    std::vector<Result> ForEachShard(Function function) const;
+};
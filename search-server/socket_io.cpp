@@ -0,0 +1,200 @@
+#include "socket_io.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const std::string& action) {
+    throw std::runtime_error(action + ": " + std::strerror(errno));
+}
+
+sockaddr_un MakeUnixAddress(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long");
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+sockaddr_in MakeInetAddress(const std::string& host, int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        throw std::invalid_argument("Invalid IPv4 address " + host);
+    }
+    return address;
+}
+
+}  // namespace
+
+int ListenUnixSocket(const std::string& path) {
+    const sockaddr_un address = MakeUnixAddress(path);
+    const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0) {
+        ThrowSystemError("socket");
+    }
+    unlink(path.c_str());
+    if (bind(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(descriptor, SOMAXCONN) < 0) {
+        close(descriptor);
+        ThrowSystemError("bind " + path);
+    }
+    return descriptor;
+}
+
+int ConnectUnixSocket(const std::string& path) {
+    const sockaddr_un address = MakeUnixAddress(path);
+    const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0) {
+        ThrowSystemError("socket");
+    }
+    if (connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        close(descriptor);
+        ThrowSystemError("connect " + path);
+    }
+    return descriptor;
+}
+
+int ListenTcpSocket(const std::string& host, int port) {
+    const sockaddr_in address = MakeInetAddress(host, port);
+    const int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+    if (descriptor < 0) {
+        ThrowSystemError("socket");
+    }
+    const int enable = 1;
+    setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(descriptor, SOMAXCONN) < 0) {
+        close(descriptor);
+        ThrowSystemError("bind " + host + ":" + std::to_string(port));
+    }
+    return descriptor;
+}
+
+int ConnectTcpSocket(const std::string& host, int port) {
+    const sockaddr_in address = MakeInetAddress(host, port);
+    const int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+    if (descriptor < 0) {
+        ThrowSystemError("socket");
+    }
+    if (connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        close(descriptor);
+        ThrowSystemError("connect " + host + ":" + std::to_string(port));
+    }
+    const int enable = 1;
+    setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return descriptor;
+}
+
+int GetLocalPort(int descriptor) {
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    if (getsockname(descriptor, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        ThrowSystemError("getsockname");
+    }
+    return ntohs(address.sin_port);
+}
+
+void SetNonBlocking(int descriptor) {
+    const int flags = fcntl(descriptor, F_GETFL, 0);
+    if (flags < 0 || fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ThrowSystemError("fcntl");
+    }
+}
+
+void ThrowRemoteError(std::string_view answer) {
+    std::string_view kind;
+    std::string_view message = answer;
+    if (answer.substr(0, 4) == "ERR\t") {
+        answer.remove_prefix(4);
+        const auto separator = answer.find('\t');
+        kind = answer.substr(0, separator);
+        message = separator == answer.npos ? answer : answer.substr(separator + 1);
+    }
+    if (kind == "invalid_argument") {
+        throw std::invalid_argument(std::string(message));
+    }
+    if (kind == "out_of_range") {
+        throw std::out_of_range(std::string(message));
+    }
+    throw std::runtime_error(std::string(message));
+}
+
+LineConnection::LineConnection(int descriptor)
+    : descriptor_(descriptor) {
+}
+
+LineConnection::LineConnection(LineConnection&& other) noexcept
+    : descriptor_(other.descriptor_)
+    , buffer_(std::move(other.buffer_)) {
+    other.descriptor_ = -1;
+}
+
+LineConnection& LineConnection::operator=(LineConnection&& other) noexcept {
+    if (this != &other) {
+        if (descriptor_ >= 0) {
+            close(descriptor_);
+        }
+        descriptor_ = other.descriptor_;
+        buffer_ = std::move(other.buffer_);
+        other.descriptor_ = -1;
+    }
+    return *this;
+}
+
+LineConnection::~LineConnection() {
+    if (descriptor_ >= 0) {
+        close(descriptor_);
+    }
+}
+
+bool LineConnection::ReadLine(std::string& line) {
+    while (true) {
+        const auto end_of_line = buffer_.find('\n');
+        if (end_of_line != buffer_.npos) {
+            line.assign(buffer_, 0, end_of_line);
+            buffer_.erase(0, end_of_line + 1);
+            return true;
+        }
+        char chunk[4096];
+        const ssize_t received = read(descriptor_, chunk, sizeof(chunk));
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+void LineConnection::WriteAll(std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = send(descriptor_, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("send");
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+}
+
+int LineConnection::GetDescriptor() const {
+    return descriptor_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Thin wrappers over POSIX sockets. Failures throw std::runtime_error with the errno text.
+
+int ListenUnixSocket(const std::string& path);
+
+int ConnectUnixSocket(const std::string& path);
+
+// Port 0 picks a free port, GetLocalPort tells which one.
+int ListenTcpSocket(const std::string& host, int port);
+
+int ConnectTcpSocket(const std::string& host, int port);
+
+int GetLocalPort(int descriptor);
+
+void SetNonBlocking(int descriptor);
+
+// Blocking connection exchanging '\n'-terminated lines.
+class LineConnection {
+public:
+    LineConnection() = default;
+
+    explicit LineConnection(int descriptor);
+
+    LineConnection(LineConnection&& other) noexcept;
+
+    LineConnection& operator=(LineConnection&& other) noexcept;
+
+    LineConnection(const LineConnection&) = delete;
+    LineConnection& operator=(const LineConnection&) = delete;
+
+    ~LineConnection();
+
+    // Returns false once the peer has closed the connection.
+    bool ReadLine(std::string& line);
+
+    void WriteAll(std::string_view data);
+
+    int GetDescriptor() const;
+
+private:
+    int descriptor_ = -1;
+    std::string buffer_;
+};
+
+// Line protocols answer failures with "ERR <exception kind> <message>" instead of dropping
+// the connection. AnswerRequest produces such a line from an escaped exception,
+// ThrowRemoteError raises the same exception type on the other side.
+template <typename Handler>
+std::string AnswerRequest(Handler handler) {
+    try {
+        return handler();
+    }
+    catch (const std::invalid_argument& e) {
+        return std::string("ERR\tinvalid_argument\t") + e.what();
+    }
+    catch (const std::out_of_range& e) {
+        return std::string("ERR\tout_of_range\t") + e.what();
+    }
+    catch (const std::exception& e) {
+        return std::string("ERR\truntime_error\t") + e.what();
+    }
+}
+
+[[noreturn]] void ThrowRemoteError(std::string_view answer);
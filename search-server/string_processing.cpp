@@ -1,18 +1,94 @@
 #include "string_processing.h"
 
+namespace {
+
+template <typename Container>
+void AppendWords(std::string_view text, Container& result) {
+    while (true) {
+        const auto begin = text.find_first_not_of(WHITESPACE);
+        if (begin == text.npos) {
+            break;
+        }
+        text.remove_prefix(begin);
+        const auto end = std::min(text.find_first_of(WHITESPACE), text.size());
+        result.push_back(text.substr(0, end));
+        text.remove_prefix(end);
+    }
+}
+
+// Position after the UTF-8 character starting at pos: continuation bytes are 10xxxxxx.
+size_t GetNextCharacter(std::string_view text, size_t pos) {
+    ++pos;
+    while (pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) {
+        ++pos;
+    }
+    return pos;
+}
+
+}  // namespace
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text)
 {
     std::vector<std::string_view> result;
-    
-    text.remove_prefix(std::min(text.find_first_not_of(" "), text.size()));
+    AppendWords(text, result);
+    return result;
+}
+
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::string_view> result(resource);
+    AppendWords(text, result);
+    return result;
+}
+
+std::vector<std::string_view> SplitIntoFields(std::string_view text, char separator) {
+    std::vector<std::string_view> result;
     while (true) {
-        auto space = text.find(' ');
-        result.push_back(space == text.npos ? text.substr(0, text.npos) : text.substr(0, space));
-        text.remove_prefix(std::min(text.find_first_not_of(" ", space), text.size()));
-        if (space == text.npos) {
+        const auto position = text.find(separator);
+        result.push_back(text.substr(0, position));
+        if (position == text.npos) {
             break;
         }
+        text.remove_prefix(position + 1);
     }
-
     return result;
+}
+
+bool IsWildcardPattern(std::string_view word) {
+    return word.find_first_of("*?") != word.npos;
+}
+
+bool MatchesWildcard(std::string_view pattern, std::string_view word) {
+    size_t pattern_pos = 0;
+    size_t word_pos = 0;
+    size_t star_pos = pattern.npos;
+    size_t star_word_pos = 0;
+
+    // Greedy matching with backtracking to the last star: linear for patterns with a single star.
+    // Literal bytes compare one by one, while '?' and '*' step over whole UTF-8 characters.
+    while (word_pos < word.size()) {
+        if (pattern_pos < pattern.size() && pattern[pattern_pos] == '?') {
+            ++pattern_pos;
+            word_pos = GetNextCharacter(word, word_pos);
+        }
+        else if (pattern_pos < pattern.size() && pattern[pattern_pos] == word[word_pos]) {
+            ++pattern_pos;
+            ++word_pos;
+        }
+        else if (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+            star_pos = pattern_pos++;
+            star_word_pos = word_pos;
+        }
+        else if (star_pos != pattern.npos) {
+            pattern_pos = star_pos + 1;
+            star_word_pos = GetNextCharacter(word, star_word_pos);
+            word_pos = star_word_pos;
+        }
+        else {
+            return false;
+        }
+    }
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+        ++pattern_pos;
+    }
+    return pattern_pos == pattern.size();
 }
\ No newline at end of file
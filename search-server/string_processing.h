@@ -1,11 +1,26 @@
 #pragma once
 
+#include <memory_resource>
 #include <set>
 #include <vector>
 #include <string>
+#include <string_view>
 
+const std::string_view WHITESPACE = " \t\n\v\f\r";
+
+// Splits on runs of whitespace; the result has no empty words.
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource);
+
+// Splits on every separator, keeping empty fields: "a\t\tb" gives "a", "", "b".
+std::vector<std::string_view> SplitIntoFields(std::string_view text, char separator);
+
+bool IsWildcardPattern(std::string_view word);
+
+// '*' matches any sequence of characters, '?' matches exactly one character.
+bool MatchesWildcard(std::string_view pattern, std::string_view word);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -1,4 +1,21 @@
 #include "test_example_functions.h"
+#include "durable_search_server.h"
+#include "paginator.h"
+#include "query_server.h"
+#include "sharded_search_server.h"
+#include "socket_io.h"
+#include "string_processing.h"
+#include "text_normalizer.h"
+
+#include <sys/socket.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
 
 void PrintDocument_(const Document& document) {
     std::cout << "{ "
@@ -49,4 +66,492 @@ void MatchDocuments(const SearchServer& search_server, const std::string_view qu
     catch (const std::exception& e) {
         std::cout << "Error during matching documents for the request " << query << ": " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+namespace {
+
+void Check(bool condition, const std::string& description) {
+    if (!condition) {
+        throw std::logic_error("Check failed: " + description);
+    }
+}
+
+bool HaveSameIds(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+        [](const Document& a, const Document& b) { return a.id == b.id; });
+}
+
+// Same documents in the same order, relevances equal up to the order of summation.
+bool HaveSameRanking(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& a, const Document& b) {
+        return a.id == b.id && a.rating == b.rating && std::abs(a.relevance - b.relevance) < 1e-9;
+        });
+}
+
+// Documents of the words w0..w39, low numbers much more common than high ones; every seventh
+// document is banned.
+void AddGeneratedDocuments(SearchServer& search_server, int document_count) {
+    std::mt19937 generator(42);
+    for (int id = 0; id < document_count; ++id) {
+        std::string text;
+        const size_t word_count = 3 + generator() % 8;
+        for (size_t i = 0; i < word_count; ++i) {
+            text += " w" + std::to_string((generator() % 40) * (generator() % 40) / 40);
+        }
+        const DocumentStatus status = id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text, status, { id % 11 - 5, id % 3 });
+    }
+}
+
+}  // namespace
+
+void TestPaging() {
+    SearchServer search_server(std::string("and"));
+    for (int id = 0; id < 23; ++id) {
+        search_server.AddDocument(id, "cat " + std::string(id % 4, 'x') + " tail" + std::to_string(id % 3),
+            DocumentStatus::ACTUAL, { id % 5 });
+    }
+    const auto all = search_server.FindTopDocuments("cat tail0", DocumentStatus::ACTUAL, 0, 100);
+    Check(all.size() == 23, "a large limit returns every match");
+    for (size_t offset : { 0, 4, 20, 22, 23, 30 }) {
+        const auto window = search_server.FindTopDocuments("cat tail0", DocumentStatus::ACTUAL, offset, 5);
+        const size_t begin = std::min(offset, all.size());
+        const std::vector<Document> expected(all.begin() + begin, all.begin() + std::min(begin + 5, all.size()));
+        Check(HaveSameIds(window, expected), "window at offset " + std::to_string(offset) + " is a slice of the ranking");
+    }
+
+    const auto pages = Paginate(all, 5);
+    Check(pages.size() == 5, "23 documents make 5 pages of 5");
+    std::vector<Document> joined;
+    for (const auto page : pages) {
+        joined.insert(joined.end(), page.begin(), page.end());
+    }
+    Check(HaveSameIds(joined, all), "pages joined give the ranking back");
+    const auto last_page = pages.GetPage(4);
+    Check(std::distance(last_page.begin(), last_page.end()) == 3, "the last page holds the remainder");
+    bool is_out_of_range = false;
+    try {
+        pages.GetPage(5);
+    }
+    catch (const std::out_of_range&) {
+        is_out_of_range = true;
+    }
+    Check(is_out_of_range, "a page past the end throws");
+}
+
+void TestPhrases() {
+    SearchServerOptions options;
+    options.positional_index = true;
+    SearchServer search_server(std::string(""), options);
+    search_server.AddDocument(1, "a1 b1 x b1 x c1", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "c1 b1 a1", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "a1 b1 c1 d1", DocumentStatus::ACTUAL, { 1 });
+
+    const auto find_ids = [&search_server](const std::string& query) {
+        std::vector<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    Check(find_ids("\"a1 b1 c1\"") == std::vector<int>{ 3 }, "an exact phrase needs adjacent words");
+    Check(find_ids("\"a1 b1 c1\"~1") == std::vector<int>{ 3 }, "slop 1 does not cover two words in a gap");
+    Check(find_ids("\"a1 b1 c1\"~2") == std::vector<int>{ 1, 3 },
+        "slop 2 matches through a later occurrence of a repeated word");
+    Check(find_ids("\"a1 c1\"~5") == std::vector<int>{ 1, 3 }, "phrase words must keep their order");
+    Check(find_ids("\"b1 a1\"") == std::vector<int>{ 2 }, "a two-word phrase matches in order");
+
+    const auto [words, status] = search_server.MatchDocument("\"a1 b1 c1\"~2", 1);
+    Check(words.size() == 3 && status == DocumentStatus::ACTUAL, "MatchDocument agrees with the phrase match");
+    Check(std::get<0>(search_server.MatchDocument("\"a1 b1 c1\"~1", 1)).empty(),
+        "MatchDocument rejects the phrase beyond its slop");
+}
+
+void TestWildcards() {
+    Check(MatchesWildcard("к?т", "кот"), "'?' matches a two-byte letter");
+    Check(!MatchesWildcard("к?т", "кт"), "'?' needs a letter");
+    Check(MatchesWildcard("??т", "кот") && !MatchesWildcard("???т", "кот"), "'?' counts letters, not bytes");
+    Check(MatchesWildcard("*т?", "котёнок") == false && MatchesWildcard("*н?к", "котёнок"),
+        "'*' backtracks over whole letters");
+    Check(MatchesWildcard("c?t", "cat") && MatchesWildcard("*", "") && !MatchesWildcard("c?t", "cart"),
+        "ASCII patterns are unaffected");
+
+    SearchServer search_server(std::string(""));
+    search_server.AddDocument(1, "кот", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "кит", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "крот", DocumentStatus::ACTUAL, { 1 });
+    Check(search_server.FindTopDocuments("к?т").size() == 2, "a query pattern expands to Cyrillic terms");
+}
+
+void TestShardedRanking() {
+    const std::vector<std::string> texts = {
+        "white cat and fashionable collar", "fluffy cat fluffy tail", "groomed dog expressive eyes",
+        "groomed starling evgeny", "cat with a collar and a dog", "fluffy dog and fluffy cat",
+        "starling on a white fence", "dog tail", "expressive cat eyes", "collar for a groomed dog",
+    };
+    SearchServer single(std::string("and a with"));
+    ShardedSearchServer sharded("and a with", 3);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        const std::vector<int> ratings = { id % 4, -id % 3 };
+        single.AddDocument(id, texts[id], DocumentStatus::ACTUAL, ratings);
+        sharded.AddDocument(id, texts[id], DocumentStatus::ACTUAL, ratings);
+    }
+    single.RemoveDocument(4);
+    sharded.RemoveDocument(4);
+
+    for (const std::string query : { "fluffy cat", "groomed dog -tail", "white starling collar", "expressive eyes" }) {
+        const auto expected = single.FindTopDocuments(query);
+        const auto actual = sharded.FindTopDocuments(query);
+        Check(HaveSameIds(actual, expected), "shards rank \"" + query + "\" like one server");
+        for (size_t i = 0; i < expected.size() && i < actual.size(); ++i) {
+            Check(std::abs(actual[i].relevance - expected[i].relevance) < 1e-9 && actual[i].rating == expected[i].rating,
+                "shards score \"" + query + "\" like one server");
+        }
+    }
+}
+
+void TestDurability() {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "search_server_durability_check";
+    const std::filesystem::path log_path = directory / "wal.log";
+    std::filesystem::remove_all(directory);
+    DurableSearchServerOptions options;
+    options.checkpoint_log_bytes = 0;
+
+    const auto get_ids = [](const DurableSearchServer& server) {
+        const SearchServer& search_server = server.GetSearchServer();
+        return std::vector<int>(search_server.begin(), search_server.end());
+    };
+    {
+        DurableSearchServer server(directory.string(), "and", options);
+        server.AddDocument(1, "white cat and collar", DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, "fluffy cat", DocumentStatus::ACTUAL, { 2 });
+        server.AddDocument(3, "groomed dog", DocumentStatus::BANNED, { 3 });
+        server.RemoveDocument(2);
+        Check(get_ids(server) == std::vector<int>{ 1, 3 }, "mutations apply at once");
+    }
+    {
+        DurableSearchServer server(directory.string(), "", options);
+        Check(get_ids(server) == std::vector<int>{ 1, 3 }, "the log is replayed on open");
+        Check(server.GetSearchServer().FindTopDocuments("and").empty(), "the stop words are kept from creation");
+        Check(server.GetSearchServer().FindTopDocuments("dog", DocumentStatus::BANNED).size() == 1, "statuses are replayed");
+    }
+
+    // A crash while the removal was being written leaves part of its record.
+    const auto full_size = std::filesystem::file_size(log_path);
+    std::filesystem::resize_file(log_path, full_size - 3);
+    {
+        DurableSearchServer server(directory.string(), "and", options);
+        Check(get_ids(server) == std::vector<int>{ 1, 2, 3 }, "a torn last record is dropped");
+        Check(std::filesystem::file_size(log_path) < full_size - 3, "the torn tail is cut off");
+        server.AddDocument(4, "starling", DocumentStatus::ACTUAL, { 4 });
+    }
+    {
+        // Garbage after the intact records is cut off the same way.
+        std::ofstream(log_path, std::ios::binary | std::ios::app) << "torn";
+        DurableSearchServer server(directory.string(), "and", options);
+        Check(get_ids(server) == std::vector<int>{ 1, 2, 3, 4 }, "records appended after a cut are replayed");
+        server.Checkpoint();
+        Check(server.GetLogSize() == 0, "a checkpoint empties the log");
+        server.RemoveDocument(100);
+        Check(server.GetLogSize() == 0, "removing an unknown id is not logged");
+        server.RemoveDocument(1);
+    }
+    {
+        DurableSearchServer server(directory.string(), "and", options);
+        Check(get_ids(server) == std::vector<int>{ 2, 3, 4 }, "the log is replayed on top of the checkpoint");
+    }
+    std::filesystem::remove_all(directory);
+}
+
+void TestTypoCorrection() {
+    SearchServerOptions options;
+    options.max_typo_edits = 2;
+    SearchServer search_server(std::string("and"), options);
+    search_server.AddDocument(1, "nasty rat", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "hasty cat and nasal spray", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "grey cat", DocumentStatus::ACTUAL, { 1 });
+
+    const auto found = search_server.FindTopDocuments("nasy");
+    Check(found.size() == 1 && found[0].id == 1, "a word one typo away finds its term");
+    Check(std::abs(found[0].relevance - 0.5 * search_server.FindTopDocuments("nasty")[0].relevance) < 1e-9,
+        "a corrected term counts with typo_weight");
+    Check(search_server.FindTopDocuments("spary").size() == 1, "swapped neighbours are one typo");
+    Check(search_server.FindTopDocuments("cat").size() == 2, "an indexed word is not corrected");
+    Check(search_server.FindTopDocuments("ct").empty(), "short words are taken as typed");
+    const std::vector<std::string_view> corrected_words = { "nasty", "rat" };
+    Check(std::get<0>(search_server.MatchDocument(std::execution::seq, "nasy rat", 1)) == corrected_words,
+        "sequential MatchDocument finds corrections");
+    Check(std::get<0>(search_server.MatchDocument(std::execution::par, "nasy rat", 1)) == corrected_words,
+        "parallel MatchDocument finds corrections");
+
+    // One correction per word: "cax" is "cat" in most documents, but the shard holding the only
+    // "car" document must not pick "car" just because it has no "cat" of its own.
+    options.max_typo_expansions = 1;
+    SearchServer single(std::string(""), options);
+    ShardedSearchServer sharded("", 3, options);
+    // More wildcard matches than MAX_TERM_EXPANSION_COUNT, each in two documents but "prezz".
+    const size_t pattern_term_count = MAX_TERM_EXPANSION_COUNT + 6;
+    const size_t first_shard_document_count = 2 + 2 * pattern_term_count;
+    std::vector<std::vector<int>> ids_by_shard(sharded.GetShardCount());
+    for (int id = 0; ids_by_shard.at(0).size() < first_shard_document_count || ids_by_shard.at(1).empty(); ++id) {
+        ids_by_shard.at(sharded.GetShardIndex(id)).push_back(id);
+    }
+    const auto add = [&single, &sharded](int id, const std::string& text) {
+        single.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+        sharded.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+    };
+    add(ids_by_shard.at(0).at(0), "cat");
+    add(ids_by_shard.at(0).at(1), "cat");
+    add(ids_by_shard.at(1).at(0), "car prezz");
+    for (size_t i = 0; i < pattern_term_count; ++i) {
+        const std::string term = "pre" + std::to_string(10 + i);
+        add(ids_by_shard.at(0).at(2 + 2 * i), term);
+        add(ids_by_shard.at(0).at(3 + 2 * i), term);
+    }
+    for (const std::string query : { "cax", "car", "pre*", "pre?? cax" }) {
+        const auto expected = single.FindTopDocuments(query);
+        const auto actual = sharded.FindTopDocuments(query);
+        Check(!expected.empty() && HaveSameIds(actual, expected), "shards expand \"" + query + "\" like one server");
+    }
+}
+
+void TestQueryServerLines() {
+    SearchServer search_server(std::string(""));
+    search_server.AddDocument(1, "cat", DocumentStatus::ACTUAL, { 1 });
+    QueryServerOptions options;
+    options.port = 0;
+    options.worker_count = 1;
+    options.max_request_length = 1000;
+    QueryServer query_server(search_server, options);
+    std::thread server_thread([&query_server] { query_server.Run(); });
+
+    // Sends the data, closes the sending side and reads every answer until the server closes.
+    const auto exchange = [&query_server](const std::string& data) {
+        LineConnection connection(ConnectTcpSocket("127.0.0.1", query_server.GetPort()));
+        connection.WriteAll(data);
+        shutdown(connection.GetDescriptor(), SHUT_WR);
+        std::vector<std::string> answers;
+        std::string line;
+        while (connection.ReadLine(line)) {
+            answers.push_back(line);
+        }
+        return answers;
+    };
+    try {
+        const auto answers = exchange("PING\nFIND\tcat");
+        Check(answers.size() == 2 && answers[0] == "OK" && answers[1].rfind("OK\t1\t", 0) == 0,
+            "a request ended by the connection is answered");
+        const auto long_line_answers = exchange("PING\n" + std::string(5000, 'x'));
+        Check(long_line_answers == std::vector<std::string>{ "OK", "ERR\tinvalid_argument\tRequest line is too long" },
+            "a line over max_request_length is answered ERR after the earlier requests");
+        Check(exchange("PING\n" + std::string(999, 'x')).size() == 2, "a last line within the limit is answered");
+    }
+    catch (...) {
+        query_server.Stop();
+        server_thread.join();
+        throw;
+    }
+    query_server.Stop();
+    server_thread.join();
+}
+
+void TestIndexStats() {
+    SearchServerOptions options;
+    options.positional_index = true;
+    SearchServer search_server(std::string("and"), options);
+    const SearchServerStats empty = search_server.GetStats();
+    Check(empty.document_count == 0 && empty.term_count == 0 && empty.posting_count == 0, "an empty index counts nothing");
+
+    search_server.AddDocument(1, "cat and dog and cat", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "dog bird", DocumentStatus::ACTUAL, { 2 });
+    const SearchServerStats added = search_server.GetStats();
+    Check(added.document_count == 2 && added.term_count == 3 && added.posting_count == 4,
+        "terms and postings are counted without stop words");
+    Check(added.posting_length_histogram == std::vector<size_t>{ 2, 1 }, "posting lengths fall into power-of-two buckets");
+    Check(!added.largest_terms.empty() && added.largest_terms[0] == std::pair<std::string, size_t>{ "dog", 2 },
+        "the longest posting list comes first");
+    for (const auto& [name, before, after] : {
+        std::tuple{ "words", empty.words, added.words },
+        std::tuple{ "word_to_document_freqs", empty.word_to_document_freqs, added.word_to_document_freqs },
+        std::tuple{ "document_to_word_freqs", empty.document_to_word_freqs, added.document_to_word_freqs },
+        std::tuple{ "documents", empty.documents, added.documents },
+        std::tuple{ "document_ids", empty.document_ids, added.document_ids },
+        std::tuple{ "positions", empty.positions, added.positions } }) {
+        Check(after.bytes > before.bytes && after.allocation_count > before.allocation_count,
+            std::string(name) + " grows when documents are added");
+    }
+    Check(added.impacts.bytes == 0 && added.typos.bytes == 0, "disabled structures take no memory");
+    Check(added.total_bytes == added.words.bytes + added.word_to_document_freqs.bytes + added.document_to_word_freqs.bytes
+        + added.documents.bytes + added.document_ids.bytes + added.positions.bytes, "the total sums the structures");
+
+    search_server.RemoveDocument(1);
+    const SearchServerStats removed = search_server.GetStats();
+    Check(removed.document_count == 1 && removed.term_count == 2 && removed.posting_count == 2,
+        "a removed document takes its postings along");
+    Check(removed.document_to_word_freqs.bytes < added.document_to_word_freqs.bytes
+        && removed.documents.bytes < added.documents.bytes && removed.document_ids.bytes < added.document_ids.bytes
+        && removed.positions.bytes < added.positions.bytes && removed.word_to_document_freqs.bytes < added.word_to_document_freqs.bytes,
+        "memory of a removed document is released");
+    Check(removed.words.bytes == added.words.bytes, "words stay in the dictionary");
+}
+
+void TestTextNormalization() {
+    const TextNormalizer normalizer;
+    const auto get_terms = [&normalizer](std::string_view text) {
+        std::vector<std::pair<std::string, bool>> terms;
+        normalizer.ForEachTerm(text, [&terms](std::string_view term, bool borrowed) { terms.emplace_back(term, borrowed); });
+        return terms;
+    };
+    using Terms = std::vector<std::pair<std::string, bool>>;
+    // 36 bytes: two 16-byte blocks of the vector scan and a tail of the byte loop.
+    const std::string long_plain = "abcdefghijklmnopqrstuvwxyz0123456789";
+    Check(get_terms(long_plain + " cat") == Terms{ { long_plain, true }, { "cat", true } }, "plain ASCII terms are borrowed");
+    Check(get_terms("abcdefghijklmnopqrsT") == Terms{ { "abcdefghijklmnopqrst", false } },
+        "a capital after the first block is folded into a copy");
+    Check(get_terms("Cat, cat\tcat.") == Terms{ { "cat", false }, { "cat", true }, { "cat", true } },
+        "case and punctuation do not change a term");
+    Check(get_terms("Ёж ЁЖ ΣΟΦΊΑ") == Terms{ { "ёж", false }, { "ёж", false }, { "σοφία", false } },
+        "Cyrillic and Greek are case folded");
+    Check(get_terms("\xD0\xB5\xCC\x88\xD0\xB6") == Terms{ { "ёж", false } }, "a combining diaeresis is composed");
+
+    SearchServer search_server(std::string("The, И"));
+    search_server.AddDocument(1, "Cat, and the Ёж", DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat\tи пёс", DocumentStatus::ACTUAL, { 1 });
+    Check(search_server.FindTopDocuments("CAT").size() == 2, "a capitalized and a tab-separated word are one term");
+    Check(search_server.FindTopDocuments("ёж").size() == 1 && search_server.FindTopDocuments("ЕЖ").empty(),
+        "Ё is folded but not merged with Е");
+    Check(search_server.FindTopDocuments("\xD0\x95\xCC\x88\xD0\xB6").size() == 1, "a decomposed query word is composed");
+    Check(search_server.FindTopDocuments("the и").empty() && search_server.GetWordFrequencies(1).count("the") == 0,
+        "stop words are normalized like the text");
+
+    const auto is_rejected = [](const auto& action) {
+        try {
+            action();
+        }
+        catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    Check(is_rejected([&search_server] { search_server.AddDocument(3, "cat\x01dog", DocumentStatus::ACTUAL, { 1 }); }),
+        "a document with a control character is rejected");
+    Check(is_rejected([&search_server] { search_server.FindTopDocuments("Ёж\x1F"); }),
+        "a query with a control character is rejected");
+    Check(search_server.GetDocumentCount() == 2, "a rejected document is not added");
+}
+
+void TestQueryEvaluation() {
+    SearchServerOptions options;
+    options.positional_index = true;
+    SearchServer search_server(std::string(""), options);
+    AddGeneratedDocuments(search_server, 400);
+    for (int id = 0; id < 400; id += 13) {
+        search_server.RemoveDocument(id);
+    }
+
+    // The sequential policy follows the plan, the parallel one always evaluates term at a time.
+    const auto check_evaluation = [&search_server](const std::string& query, QueryEvaluation evaluation) {
+        const std::string name(GetQueryEvaluationName(evaluation));
+        Check(search_server.ExplainQuery(query).evaluation == evaluation, "\"" + query + "\" is planned " + name);
+        const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && rating >= 0 && document_id % 2 == 1;
+        };
+        const auto found = search_server.FindTopDocuments(std::execution::seq, query);
+        Check(found.size() == MAX_RESULT_DOCUMENT_COUNT, "\"" + query + "\" fills a page");
+        Check(HaveSameRanking(found, search_server.FindTopDocuments(std::execution::par, query)),
+            name + " ranks \"" + query + "\" like term at a time");
+        Check(HaveSameRanking(search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED),
+            search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED)), name + " filters by status");
+        Check(HaveSameRanking(search_server.FindTopDocuments(std::execution::seq, query, predicate),
+            search_server.FindTopDocuments(std::execution::par, query, predicate)), name + " filters by a predicate");
+        Check(HaveSameRanking(search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, 7, 20),
+            search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, 7, 20)), name + " cuts the same window");
+    };
+    check_evaluation("w0 w1 -w3", QueryEvaluation::DOCUMENT_AT_A_TIME);
+    check_evaluation("w2 \"w0 w1\"~3", QueryEvaluation::DOCUMENT_AT_A_TIME);
+    check_evaluation("w20 w22 w24 w25 w26 w27 w28 w29 w30 w31 w32 w33 w34 w35 w36 w37 w38 -w21", QueryEvaluation::TERM_AT_A_TIME);
+
+    for (const std::string query : { "w99", "-w0 w98", "w0 \"w1 w99\"" }) {
+        Check(search_server.ExplainQuery(query).evaluation == QueryEvaluation::EMPTY, "\"" + query + "\" cannot match");
+        Check(search_server.FindTopDocuments(query).empty(), "\"" + query + "\" finds nothing");
+    }
+
+    const QueryPlan plan = search_server.ExplainQuery("w30 w0 w9 w1 w20 -w2 -w35 -w10 w98");
+    const auto is_shorter = [](const PlannedTerm& lhs, const PlannedTerm& rhs) { return lhs.posting_count < rhs.posting_count; };
+    Check(plan.plus_terms.size() == 5 && std::is_sorted(plan.plus_terms.begin(), plan.plus_terms.end(), is_shorter),
+        "plus terms are listed shortest posting list first");
+    Check(plan.minus_terms.size() == 3 && std::is_sorted(plan.minus_terms.begin(), plan.minus_terms.end(), is_shorter),
+        "minus terms are listed shortest posting list first");
+    Check(plan.missing_terms == std::vector<std::string>{ "w98" }, "words not in the index are listed apart");
+}
+
+void TestImpactOrdering() {
+    SearchServer exact(std::string(""));
+    SearchServerOptions options;
+    options.impact_ordered_postings = true;
+    SearchServer by_impact(std::string(""), options);
+    for (SearchServer* search_server : { &exact, &by_impact }) {
+        AddGeneratedDocuments(*search_server, 600);
+        for (int id = 0; id < 600; id += 17) {
+            search_server->RemoveDocument(id);
+        }
+    }
+
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating > 0 && document_id % 3 != 0;
+    };
+    const auto check_same = [&exact, &predicate](const SearchServer& search_server, const std::string& description) {
+        for (const std::string query : { "w0 w1", "w0 w2 -w5", "w3 w4 w6 -w1", "w1 w7" }) {
+            Check(search_server.ExplainQuery(query).evaluation == QueryEvaluation::IMPACT_ORDERED,
+                description + ": \"" + query + "\" is read by impact");
+            const auto found = search_server.FindTopDocuments(query);
+            Check(found.size() == MAX_RESULT_DOCUMENT_COUNT && HaveSameRanking(found, exact.FindTopDocuments(query)),
+                description + ": \"" + query + "\" finds the exact top");
+            Check(HaveSameRanking(search_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                exact.FindTopDocuments(query, DocumentStatus::BANNED)), description + ": \"" + query + "\" filters by status");
+            Check(HaveSameRanking(search_server.FindTopDocuments(query, predicate), exact.FindTopDocuments(query, predicate)),
+                description + ": \"" + query + "\" filters by a predicate");
+            Check(HaveSameRanking(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 5, 10),
+                exact.FindTopDocuments(query, DocumentStatus::ACTUAL, 5, 10)), description + ": \"" + query + "\" cuts the same window");
+        }
+    };
+    check_same(by_impact, "impact-ordered postings");
+
+    std::stringstream snapshot;
+    exact.WriteSnapshot(snapshot);
+    check_same(SearchServer::ReadSnapshot(snapshot, options), "impact-ordered postings rebuilt from a snapshot");
+
+    // Every posting read scores at most one new document.
+    options.max_impact_postings = 3;
+    snapshot.clear();
+    snapshot.seekg(0);
+    const SearchServer budgeted = SearchServer::ReadSnapshot(snapshot, options);
+    std::map<int, double> exact_relevances;
+    for (const Document& document : exact.FindTopDocuments("w0 w1", DocumentStatus::ACTUAL, 0, 1000)) {
+        exact_relevances[document.id] = document.relevance;
+    }
+    const auto approximate = budgeted.FindTopDocuments("w0 w1");
+    Check(!approximate.empty() && approximate.size() <= 3, "max_impact_postings bounds the documents scored");
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    Check(budgeted.FindTopDocumentsTraced("w0 w1").second.postings_visited == 3, "max_impact_postings bounds the postings read");
+#endif
+    for (const Document& document : approximate) {
+        Check(exact_relevances.count(document.id) > 0 && std::abs(exact_relevances.at(document.id) - document.relevance) < 1e-9,
+            "a document found within the budget has its exact relevance");
+    }
+}
+
+void TestSearchServer() {
+    TestPaging();
+    TestPhrases();
+    TestWildcards();
+    TestShardedRanking();
+    TestDurability();
+    TestTypoCorrection();
+    TestQueryServerLines();
+    TestIndexStats();
+    TestTextNormalization();
+    TestQueryEvaluation();
+    TestImpactOrdering();
+}
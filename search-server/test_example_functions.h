@@ -8,4 +8,46 @@ void PrintMatchDocumentResult(int document_id, const std::vector<std::string>& w
 
 void FindTopDocuments(const SearchServer& search_server, const std::string_view raw_query);
 
-void MatchDocuments(const SearchServer& search_server, const std::string_view query);
\ No newline at end of file
+void MatchDocuments(const SearchServer& search_server, const std::string_view query);
+
+// Behavioral checks of the search server. Each throws std::logic_error naming the failed check.
+
+// Offset/limit windows and Paginator pages cut the full ranking without reordering it.
+void TestPaging();
+
+// Quoted phrases match words in order within the slop, wherever the occurrences of a repeated word are.
+void TestPhrases();
+
+// '?' stands for one UTF-8 character and '*' for any number of them, in patterns and queries.
+void TestWildcards();
+
+// A sharded collection ranks like a single server holding all of its documents.
+void TestShardedRanking();
+
+// A reopened durable server replays its log, drops a torn last record and restores checkpoints.
+void TestDurability();
+
+// Misspelled words find indexed terms, with the same corrections in parallel and sharded queries.
+void TestTypoCorrection();
+
+// The query server answers a last request cut off by the end of the connection and rejects
+// request lines over max_request_length.
+void TestQueryServerLines();
+
+// GetStats follows AddDocument and RemoveDocument in its counts and per-structure bytes.
+void TestIndexStats();
+
+// Case, punctuation and combining accents do not change terms of documents, queries and stop
+// words; plain ASCII terms are borrowed from the text, the others normalized into a copy.
+void TestTextNormalization();
+
+// Document-at-a-time and term-at-a-time evaluation rank alike, queries that cannot match are
+// planned EMPTY and ExplainQuery lists terms shortest posting list first.
+void TestQueryEvaluation();
+
+// Impact-ordered evaluation finds the exact top documents, and max_impact_postings bounds the
+// postings it reads.
+void TestImpactOrdering();
+
+// Runs every check above.
+void TestSearchServer();
@@ -0,0 +1,409 @@
+#include "text_normalizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+enum class ByteClass : std::uint8_t {
+    PLAIN,      // a-z, 0-9: already normalized
+    UPPER,      // A-Z
+    WILDCARD,   // '*' and '?'
+    SEPARATOR,  // whitespace, punctuation, DEL
+    INVALID,    // other control characters
+    NON_ASCII,
+};
+
+constexpr std::array<ByteClass, 256> MakeByteClasses() {
+    std::array<ByteClass, 256> classes{};
+    for (int byte = 0; byte < 256; ++byte) {
+        if (byte >= 0x80) {
+            classes[byte] = ByteClass::NON_ASCII;
+        }
+        else if ((byte >= 'a' && byte <= 'z') || (byte >= '0' && byte <= '9')) {
+            classes[byte] = ByteClass::PLAIN;
+        }
+        else if (byte >= 'A' && byte <= 'Z') {
+            classes[byte] = ByteClass::UPPER;
+        }
+        else if (byte == '*' || byte == '?') {
+            classes[byte] = ByteClass::WILDCARD;
+        }
+        else if (byte < ' ' && !(byte >= '\t' && byte <= '\r')) {
+            classes[byte] = ByteClass::INVALID;
+        }
+        else {
+            classes[byte] = ByteClass::SEPARATOR;
+        }
+    }
+    return classes;
+}
+
+constexpr std::array<ByteClass, 256> BYTE_CLASSES = MakeByteClasses();
+
+ByteClass ClassOf(char byte) {
+    return BYTE_CLASSES[static_cast<unsigned char>(byte)];
+}
+
+[[noreturn]] void ThrowInvalidSymbol() {
+    throw std::invalid_argument("Some words have invalid symbols");
+}
+
+// Code points outside ASCII that separate words: spaces, punctuation, symbols, emoji.
+// Sorted, non-overlapping, inclusive.
+constexpr std::pair<char32_t, char32_t> SEPARATOR_RANGES[] = {
+    { 0x0080, 0x00A9 },  // C1 controls, no-break space, Latin-1 signs; ª µ º are letters
+    { 0x00AB, 0x00B4 },
+    { 0x00B6, 0x00B9 },
+    { 0x00BB, 0x00BF },
+    { 0x00D7, 0x00D7 },
+    { 0x00F7, 0x00F7 },
+    { 0x037E, 0x037E },  // Greek question mark
+    { 0x0387, 0x0387 },
+    { 0x055A, 0x055F },  // Armenian punctuation
+    { 0x0589, 0x058A },
+    { 0x2000, 0x200B },  // spaces; zero-width joiners stay inside words
+    { 0x200E, 0x206F },  // dashes, quotes, ellipsis, bullets
+    { 0x20A0, 0x20CF },  // currency signs
+    { 0x2190, 0x23FF },  // arrows, mathematical operators, technical symbols
+    { 0x2500, 0x27BF },  // box drawing, shapes, dingbats
+    { 0x2E00, 0x2E7F },  // supplemental punctuation
+    { 0x3000, 0x303F },  // CJK punctuation
+    { 0xFE10, 0xFE1F },
+    { 0xFE30, 0xFE6F },
+    { 0xFEFF, 0xFEFF },  // byte order mark
+    { 0xFF01, 0xFF0F },  // fullwidth punctuation
+    { 0xFF1A, 0xFF20 },
+    { 0xFF3B, 0xFF40 },
+    { 0xFF5B, 0xFF65 },
+    { 0x1F000, 0x1FAFF },  // emoji and pictographs
+};
+
+bool IsSeparator(char32_t code_point) {
+    const auto it = std::upper_bound(std::begin(SEPARATOR_RANGES), std::end(SEPARATOR_RANGES), code_point,
+        [](char32_t value, const std::pair<char32_t, char32_t>& range) { return value < range.first; });
+    return it != std::begin(SEPARATOR_RANGES) && code_point <= std::prev(it)->second;
+}
+
+bool IsCombiningMark(char32_t code_point) {
+    return code_point >= 0x0300 && code_point <= 0x036F;
+}
+
+// In blocks where upper and lower case alternate, the upper-case letter has an even or an odd code point.
+char32_t LowerEvenPair(char32_t code_point) {
+    return code_point % 2 == 0 ? code_point + 1 : code_point;
+}
+
+char32_t LowerOddPair(char32_t code_point) {
+    return code_point % 2 == 1 ? code_point + 1 : code_point;
+}
+
+// Simple case folding of the alphabets we index; the result is never longer in UTF-8.
+char32_t FoldCase(char32_t c) {
+    if (c < 0x00C0) {
+        return c;
+    }
+    if (c <= 0x00DE) {
+        return c == 0x00D7 ? c : c + 0x20;
+    }
+    if (c >= 0x0100 && c <= 0x017F) {
+        switch (c) {
+        case 0x0130: return U'i';
+        case 0x0131: case 0x0138: case 0x0149: return c;
+        case 0x0178: return 0x00FF;
+        case 0x017F: return U's';
+        }
+        if ((c >= 0x0139 && c <= 0x0148) || (c >= 0x0179 && c <= 0x017E)) {
+            return LowerOddPair(c);
+        }
+        return LowerEvenPair(c);
+    }
+    if ((c >= 0x0200 && c <= 0x021F) || (c >= 0x0222 && c <= 0x0233)) {
+        return LowerEvenPair(c);
+    }
+    if (c >= 0x0386 && c <= 0x03AB) {
+        if (c == 0x0386) {
+            return 0x03AC;
+        }
+        if (c >= 0x0388 && c <= 0x038A) {
+            return c + 0x25;
+        }
+        if (c == 0x038C) {
+            return 0x03CC;
+        }
+        if (c == 0x038E || c == 0x038F) {
+            return c + 0x3F;
+        }
+        return c >= 0x0391 && c != 0x03A2 ? c + 0x20 : c;
+    }
+    if (c == 0x03C2) {
+        return 0x03C3;  // final sigma
+    }
+    if (c >= 0x0400 && c <= 0x052F) {
+        if (c <= 0x040F) {
+            return c + 0x50;
+        }
+        if (c <= 0x042F) {
+            return c + 0x20;
+        }
+        if ((c >= 0x0460 && c <= 0x0481) || (c >= 0x048A && c <= 0x04BF) || c >= 0x04D0) {
+            return LowerEvenPair(c);
+        }
+        if (c == 0x04C0) {
+            return 0x04CF;
+        }
+        if (c >= 0x04C1 && c <= 0x04CE) {
+            return LowerOddPair(c);
+        }
+        return c;
+    }
+    if (c >= 0x0531 && c <= 0x0556) {
+        return c + 0x30;
+    }
+    if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF)) {
+        return LowerEvenPair(c);
+    }
+    switch (c) {
+    case 0x1E9E: return 0x00DF;
+    case 0x2126: return 0x03C9;
+    case 0x212A: return U'k';
+    case 0x212B: return 0x00E5;
+    }
+    if (c >= 0xFF21 && c <= 0xFF3A) {
+        return c + 0x20;
+    }
+    return c;
+}
+
+struct Composition {
+    char32_t base;
+    char32_t mark;
+    char32_t composed;
+};
+
+// Lower-case letter + combining mark pairs seen in decomposed (NFD) Latin and Cyrillic text.
+constexpr Composition COMPOSITIONS[] = {
+    { U'a', 0x0300, 0x00E0 }, { U'e', 0x0300, 0x00E8 }, { U'i', 0x0300, 0x00EC }, { U'o', 0x0300, 0x00F2 },
+    { U'u', 0x0300, 0x00F9 },
+    { U'a', 0x0301, 0x00E1 }, { U'e', 0x0301, 0x00E9 }, { U'i', 0x0301, 0x00ED }, { U'o', 0x0301, 0x00F3 },
+    { U'u', 0x0301, 0x00FA }, { U'y', 0x0301, 0x00FD }, { U'c', 0x0301, 0x0107 }, { U'n', 0x0301, 0x0144 },
+    { U's', 0x0301, 0x015B }, { U'z', 0x0301, 0x017A },
+    { U'a', 0x0302, 0x00E2 }, { U'e', 0x0302, 0x00EA }, { U'i', 0x0302, 0x00EE }, { U'o', 0x0302, 0x00F4 },
+    { U'u', 0x0302, 0x00FB },
+    { U'a', 0x0303, 0x00E3 }, { U'n', 0x0303, 0x00F1 }, { U'o', 0x0303, 0x00F5 },
+    { U'a', 0x0306, 0x0103 }, { U'g', 0x0306, 0x011F }, { 0x0438, 0x0306, 0x0439 }, { 0x0443, 0x0306, 0x045E },
+    { U'a', 0x0308, 0x00E4 }, { U'e', 0x0308, 0x00EB }, { U'i', 0x0308, 0x00EF }, { U'o', 0x0308, 0x00F6 },
+    { U'u', 0x0308, 0x00FC }, { U'y', 0x0308, 0x00FF }, { 0x0435, 0x0308, 0x0451 }, { 0x0456, 0x0308, 0x0457 },
+    { U'a', 0x030A, 0x00E5 }, { U'u', 0x030A, 0x016F },
+    { U'c', 0x030C, 0x010D }, { U'e', 0x030C, 0x011B }, { U'n', 0x030C, 0x0148 }, { U'r', 0x030C, 0x0159 },
+    { U's', 0x030C, 0x0161 }, { U'z', 0x030C, 0x017E },
+    { U'c', 0x0327, 0x00E7 }, { U's', 0x0327, 0x015F },
+};
+
+char32_t Compose(char32_t base, char32_t mark) {
+    for (const Composition& composition : COMPOSITIONS) {
+        if (composition.base == base && composition.mark == mark) {
+            return composition.composed;
+        }
+    }
+    return 0;
+}
+
+// Decodes the UTF-8 sequence at text[position]. Returns its length, or 0 if it is malformed:
+// truncated, overlong, a surrogate or beyond U+10FFFF.
+size_t DecodeUtf8(std::string_view text, size_t position, char32_t& code_point) {
+    const auto byte = [&text](size_t index) { return static_cast<unsigned char>(text[index]); };
+    const unsigned char lead = byte(position);
+    size_t length = 0;
+    char32_t min_value = 0;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        code_point = lead & 0x1F;
+        min_value = 0x80;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        code_point = lead & 0x0F;
+        min_value = 0x800;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        code_point = lead & 0x07;
+        min_value = 0x10000;
+    }
+    if (length == 0 || text.size() - position < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((byte(position + i) & 0xC0) != 0x80) {
+            return 0;
+        }
+        code_point = (code_point << 6) | (byte(position + i) & 0x3F);
+    }
+    if (code_point < min_value || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+void AppendUtf8(std::string& out, char32_t code_point) {
+    if (code_point < 0x80) {
+        out.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else if (code_point < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+}  // namespace
+
+TextNormalizer::TextNormalizer(Stemmer stemmer)
+    : stemmer_(std::move(stemmer)) {
+}
+
+size_t TextNormalizer::SpanPlainBytes(std::string_view text, size_t position) {
+    const char* const begin = text.data() + position;
+    const char* const end = text.data() + text.size();
+    const char* it = begin;
+#if defined(__SSE2__)
+    // Signed comparisons: bytes of multi-byte UTF-8 sequences are negative and fail both ranges.
+    const __m128i before_a = _mm_set1_epi8('a' - 1);
+    const __m128i after_z = _mm_set1_epi8('z' + 1);
+    const __m128i before_0 = _mm_set1_epi8('0' - 1);
+    const __m128i after_9 = _mm_set1_epi8('9' + 1);
+    for (; end - it >= 16; it += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+        const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(bytes, before_a), _mm_cmplt_epi8(bytes, after_z));
+        const __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(bytes, before_0), _mm_cmplt_epi8(bytes, after_9));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(letters, digits)));
+        if (mask != 0xFFFF) {
+            return it - begin + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while (it != end && ClassOf(*it) == ByteClass::PLAIN) {
+        ++it;
+    }
+    return it - begin;
+}
+
+bool TextNormalizer::IsPlainTermEnd(std::string_view text, size_t position, bool keep_wildcards) {
+    if (position == text.size()) {
+        return true;
+    }
+    const ByteClass byte_class = ClassOf(text[position]);
+    return byte_class == ByteClass::SEPARATOR || (byte_class == ByteClass::WILDCARD && !keep_wildcards);
+}
+
+size_t TextNormalizer::SkipSeparators(std::string_view text, size_t position, bool keep_wildcards) {
+    while (position < text.size()) {
+        switch (ClassOf(text[position])) {
+        case ByteClass::SEPARATOR:
+            ++position;
+            break;
+        case ByteClass::WILDCARD:
+            if (keep_wildcards) {
+                return position;
+            }
+            ++position;
+            break;
+        case ByteClass::INVALID:
+            ThrowInvalidSymbol();
+        case ByteClass::NON_ASCII: {
+            char32_t code_point = 0;
+            const size_t length = DecodeUtf8(text, position, code_point);
+            if (length == 0 || !IsSeparator(code_point)) {
+                return position;
+            }
+            position += length;
+            break;
+        }
+        default:
+            return position;
+        }
+    }
+    return position;
+}
+
+size_t TextNormalizer::ReadTerm(std::string_view text, size_t position, bool keep_wildcards, std::string& term) {
+    term.clear();
+    // The last code point written and where it starts in term, for composing combining marks.
+    char32_t last = 0;
+    size_t last_start = 0;
+    while (position < text.size()) {
+        const char byte = text[position];
+        switch (ClassOf(byte)) {
+        case ByteClass::PLAIN:
+            last_start = term.size();
+            last = static_cast<char32_t>(byte);
+            term.push_back(byte);
+            ++position;
+            break;
+        case ByteClass::UPPER:
+            last_start = term.size();
+            last = static_cast<char32_t>(byte - 'A' + 'a');
+            term.push_back(static_cast<char>(last));
+            ++position;
+            break;
+        case ByteClass::WILDCARD:
+            if (!keep_wildcards) {
+                return position;
+            }
+            last = 0;
+            term.push_back(byte);
+            ++position;
+            break;
+        case ByteClass::SEPARATOR:
+            return position;
+        case ByteClass::INVALID:
+            ThrowInvalidSymbol();
+        case ByteClass::NON_ASCII: {
+            char32_t code_point = 0;
+            const size_t length = DecodeUtf8(text, position, code_point);
+            if (length == 0) {
+                // Not UTF-8: keep the byte, so such text is still searchable by its exact bytes.
+                last = 0;
+                term.push_back(byte);
+                ++position;
+                break;
+            }
+            if (IsSeparator(code_point)) {
+                return position;
+            }
+            position += length;
+            if (IsCombiningMark(code_point) && last != 0) {
+                if (const char32_t composed = Compose(last, code_point)) {
+                    term.resize(last_start);
+                    AppendUtf8(term, composed);
+                    last = composed;
+                    break;
+                }
+            }
+            last_start = term.size();
+            last = FoldCase(code_point);
+            AppendUtf8(term, last);
+            break;
+        }
+        }
+    }
+    return position;
+}
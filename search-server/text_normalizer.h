@@ -0,0 +1,78 @@
+#pragma once
+
+#include "string_processing.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Turns text into index terms. Terms are maximal runs of letters and digits: whitespace, ASCII
+// and Unicode punctuation and symbols separate them. UTF-8 is decoded, letters are case folded
+// (Latin, Greek, Cyrillic, Armenian) and the common combining accents are composed, so "Ёж",
+// "ёж," and "ёж" give the same term. Bytes that are not valid UTF-8 are kept as they are.
+//
+// Text that is already normalized, lower-case ASCII letters and digits, is scanned 16 bytes at a
+// time and its terms are handed out as views into the text without being copied.
+class TextNormalizer {
+public:
+    // Rewrites a normalized term in place, e.g. cuts off an inflectional ending. A term the
+    // stemmer leaves empty is dropped.
+    using Stemmer = std::function<void(std::string& term)>;
+
+    explicit TextNormalizer(Stemmer stemmer = nullptr);
+
+    // Calls handler(term, borrowed) for every term of text in order. A borrowed term points into
+    // text; any other one lives only until the handler returns. With keep_wildcards '*' and '?'
+    // stay inside terms, as query patterns need, and such patterns are not stemmed.
+    // Throws std::invalid_argument if text has control characters other than whitespace.
+    template <typename Handler>
+    void ForEachTerm(std::string_view text, Handler&& handler, bool keep_wildcards = false) const;
+
+private:
+    Stemmer stemmer_;
+
+    // Number of bytes from position on that are ASCII lower-case letters or digits.
+    static size_t SpanPlainBytes(std::string_view text, size_t position);
+
+    // Whether a term ending before text[position] ends there without normalization.
+    static bool IsPlainTermEnd(std::string_view text, size_t position, bool keep_wildcards);
+
+    static size_t SkipSeparators(std::string_view text, size_t position, bool keep_wildcards);
+
+    // Writes the normalized term starting at position to term and returns where it ends.
+    static size_t ReadTerm(std::string_view text, size_t position, bool keep_wildcards, std::string& term);
+};
+
+template <typename Handler>
+void TextNormalizer::ForEachTerm(std::string_view text, Handler&& handler, bool keep_wildcards) const {
+    std::string buffer;
+    size_t position = SkipSeparators(text, 0, keep_wildcards);
+    while (position < text.size()) {
+        std::string_view term;
+        bool borrowed = true;
+        size_t end = position + SpanPlainBytes(text, position);
+        if (end > position && IsPlainTermEnd(text, end, keep_wildcards)) {
+            term = text.substr(position, end - position);
+        }
+        else {
+            end = ReadTerm(text, position, keep_wildcards, buffer);
+            term = buffer;
+            borrowed = false;
+        }
+
+        if (stemmer_ && !(keep_wildcards && IsWildcardPattern(term))) {
+            if (borrowed) {
+                buffer.assign(term);
+            }
+            stemmer_(buffer);
+            if (!borrowed || buffer != term) {
+                term = buffer;
+                borrowed = false;
+            }
+        }
+        if (!term.empty()) {
+            handler(term, borrowed);
+        }
+        position = SkipSeparators(text, end, keep_wildcards);
+    }
+}
@@ -0,0 +1,236 @@
+#include "typo_index.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+const size_t MIN_TYPO_INDEX_SIZE = 1024;
+
+// Letters of a word with the byte offsets where they start, word.size() last.
+struct Letters {
+    // Bytes of each letter packed into one number, so letters compare as numbers.
+    std::array<std::uint32_t, MAX_TYPO_WORD_LENGTH> codes;
+    std::array<std::uint8_t, MAX_TYPO_WORD_LENGTH + 1> starts;
+    size_t count = 0;
+};
+
+// Returns false if the word has more than MAX_TYPO_WORD_LENGTH letters.
+bool SplitLetters(std::string_view word, Letters& letters) {
+    if (word.size() > MAX_TYPO_WORD_LENGTH * 4) {
+        return false;
+    }
+    letters.count = 0;
+    for (size_t i = 0; i < word.size(); ++i) {
+        const auto byte = static_cast<unsigned char>(word[i]);
+        if (i == 0 || (byte & 0xC0) != 0x80) {
+            if (letters.count == MAX_TYPO_WORD_LENGTH) {
+                return false;
+            }
+            letters.starts[letters.count] = static_cast<std::uint8_t>(i);
+            letters.codes[letters.count++] = byte;
+        }
+        else {
+            letters.codes[letters.count - 1] = letters.codes[letters.count - 1] << 8 | byte;
+        }
+    }
+    letters.starts[letters.count] = static_cast<std::uint8_t>(word.size());
+    return true;
+}
+
+// Fingerprint of word without the letters first and second; a position equal to the letter
+// count deletes nothing.
+std::uint32_t ComputeVariantFingerprint(std::string_view word, const Letters& letters, size_t first, size_t second) {
+    std::uint64_t hash = 0xCBF29CE484222325;  // FNV-1a
+    const auto feed = [&hash, word](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(word[i])) * 0x100000001B3;
+        }
+    };
+    const size_t size = word.size();
+    const size_t first_begin = letters.starts[first];
+    const size_t first_end = first < letters.count ? letters.starts[first + 1] : size;
+    const size_t second_begin = letters.starts[second];
+    const size_t second_end = second < letters.count ? letters.starts[second + 1] : size;
+    feed(0, first_begin);
+    feed(first_end, second_begin);
+    feed(second_end, size);
+
+    // FNV leaves the low bits, which pick the slot, poorly mixed.
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+    const auto fingerprint = static_cast<std::uint32_t>(hash ^ (hash >> 32));
+    return fingerprint == 0 ? 1 : fingerprint;
+}
+
+// Calls handler(fingerprint, deleted_count) for the word and every variant with up to max_deletes
+// letters deleted; equal variants come up more than once.
+template <typename Handler>
+void ForEachVariant(std::string_view word, const Letters& letters, size_t max_deletes, Handler handler) {
+    const size_t n = letters.count;
+    handler(ComputeVariantFingerprint(word, letters, n, n), 0);
+    for (size_t i = 0; max_deletes >= 1 && i < n; ++i) {
+        handler(ComputeVariantFingerprint(word, letters, i, n), 1);
+        for (size_t j = i + 1; max_deletes >= 2 && j < n; ++j) {
+            handler(ComputeVariantFingerprint(word, letters, i, j), 2);
+        }
+    }
+}
+
+// Shortest common string a query word within its allowed typos can share with a term that lost
+// deleted_count letters: one typo is allowed from MIN_ONE_TYPO_WORD_LENGTH letters, two from
+// MIN_TWO_TYPO_WORD_LENGTH. Shorter variants of terms are never looked up.
+size_t GetMinVariantLength(size_t deleted_count) {
+    return deleted_count < 2 ? MIN_ONE_TYPO_WORD_LENGTH - 1 : MIN_TWO_TYPO_WORD_LENGTH - 2;
+}
+
+// Optimal string alignment distance: insertions, deletions, substitutions and swaps of adjacent
+// letters, each letter edited once. Returns max_distance + 1 for anything above max_distance.
+size_t ComputeEditDistance(const Letters& lhs, const Letters& rhs, size_t max_distance) {
+    const size_t lhs_count = lhs.count;
+    const size_t rhs_count = rhs.count;
+    if (std::max(lhs_count, rhs_count) - std::min(lhs_count, rhs_count) > max_distance) {
+        return max_distance + 1;
+    }
+
+    std::array<size_t, MAX_TYPO_WORD_LENGTH + 1> before_previous;
+    std::array<size_t, MAX_TYPO_WORD_LENGTH + 1> previous;
+    std::array<size_t, MAX_TYPO_WORD_LENGTH + 1> current;
+    for (size_t j = 0; j <= rhs_count; ++j) {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= lhs_count; ++i) {
+        current[0] = i;
+        size_t row_min = current[0];
+        for (size_t j = 1; j <= rhs_count; ++j) {
+            const bool is_same = lhs.codes[i - 1] == rhs.codes[j - 1];
+            current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (is_same ? 0 : 1) });
+            if (i > 1 && j > 1 && lhs.codes[i - 1] == rhs.codes[j - 2] && lhs.codes[i - 2] == rhs.codes[j - 1]) {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = std::min(row_min, current[j]);
+        }
+        if (row_min > max_distance) {
+            return max_distance + 1;
+        }
+        before_previous = previous;
+        previous = current;
+    }
+    return std::min(previous[rhs_count], max_distance + 1);
+}
+
+}  // namespace
+
+TypoIndex::TypoIndex(size_t max_edits, std::pmr::memory_resource* resource)
+    : max_edits_(max_edits)
+    , terms_(resource)
+    , entries_(resource) {
+    if (max_edits > 2) {
+        throw std::invalid_argument("At most two typos per word are supported");
+    }
+}
+
+void TypoIndex::Add(std::string_view term) {
+    Letters letters;
+    if (max_edits_ == 0 || !SplitLetters(term, letters)) {
+        return;
+    }
+
+    std::vector<std::uint32_t> fingerprints;
+    ForEachVariant(term, letters, max_edits_, [&fingerprints, &letters](std::uint32_t fingerprint, size_t deleted_count) {
+        if (letters.count - deleted_count >= GetMinVariantLength(deleted_count)) {
+            fingerprints.push_back(fingerprint);
+        }
+        });
+    if (fingerprints.empty()) {
+        return;
+    }
+    std::sort(fingerprints.begin(), fingerprints.end());
+    fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+
+    const auto term_number = static_cast<std::uint32_t>(terms_.size());
+    terms_.push_back(term);
+    for (const std::uint32_t fingerprint : fingerprints) {
+        Insert({ fingerprint, term_number });
+    }
+}
+
+size_t TypoIndex::GetAllowedEdits(std::string_view word) const {
+    Letters letters;
+    if (!SplitLetters(word, letters) || letters.count < MIN_ONE_TYPO_WORD_LENGTH) {
+        return 0;
+    }
+    return std::min(max_edits_, letters.count < MIN_TWO_TYPO_WORD_LENGTH ? size_t{ 1 } : size_t{ 2 });
+}
+
+std::pmr::vector<TypoMatch> TypoIndex::FindMatches(std::string_view word, std::pmr::memory_resource* resource) const {
+    std::pmr::vector<TypoMatch> matches(resource);
+    const size_t max_edits = GetAllowedEdits(word);
+    if (max_edits == 0 || entries_.empty()) {
+        return matches;
+    }
+    Letters letters;
+    SplitLetters(word, letters);
+
+    std::pmr::vector<std::uint32_t> fingerprints(resource);
+    ForEachVariant(word, letters, max_edits, [&fingerprints](std::uint32_t fingerprint, size_t) {
+        fingerprints.push_back(fingerprint);
+        });
+    std::sort(fingerprints.begin(), fingerprints.end());
+    fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+
+    std::pmr::vector<std::uint32_t> candidates(resource);
+    const size_t mask = entries_.size() - 1;
+    for (const std::uint32_t fingerprint : fingerprints) {
+        for (size_t slot = fingerprint & mask; entries_[slot].fingerprint != 0; slot = (slot + 1) & mask) {
+            if (entries_[slot].fingerprint == fingerprint) {
+                candidates.push_back(entries_[slot].term);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    Letters term_letters;
+    for (const std::uint32_t candidate : candidates) {
+        const std::string_view term = terms_[candidate];
+        SplitLetters(term, term_letters);
+        const size_t edit_count = ComputeEditDistance(letters, term_letters, max_edits);
+        if (edit_count <= max_edits) {
+            matches.push_back({ term, edit_count });
+        }
+    }
+    return matches;
+}
+
+size_t TypoIndex::CountTypos(std::string_view word, std::string_view term) const {
+    const size_t max_edits = GetAllowedEdits(word);
+    Letters letters;
+    Letters term_letters;
+    if (max_edits == 0 || !SplitLetters(word, letters) || !SplitLetters(term, term_letters)) {
+        return max_edits + 1;
+    }
+    return ComputeEditDistance(letters, term_letters, max_edits);
+}
+
+void TypoIndex::Insert(Entry entry) {
+    if ((entry_count_ + 1) * 2 > entries_.size()) {
+        std::pmr::vector<Entry> entries(std::max(entries_.size() * 2, MIN_TYPO_INDEX_SIZE), entries_.get_allocator());
+        entries.swap(entries_);
+        entry_count_ = 0;
+        for (const Entry& old_entry : entries) {
+            if (old_entry.fingerprint != 0) {
+                Insert(old_entry);
+            }
+        }
+    }
+    const size_t mask = entries_.size() - 1;
+    size_t slot = entry.fingerprint & mask;
+    while (entries_[slot].fingerprint != 0) {
+        slot = (slot + 1) & mask;
+    }
+    entries_[slot] = entry;
+    ++entry_count_;
+}
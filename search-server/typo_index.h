@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Words under this many letters are taken as typed, words under MIN_TWO_TYPO_WORD_LENGTH may
+// have one typo; letters are UTF-8 code points.
+const size_t MIN_ONE_TYPO_WORD_LENGTH = 3;
+const size_t MIN_TWO_TYPO_WORD_LENGTH = 6;
+// Longer words are neither indexed nor corrected.
+const size_t MAX_TYPO_WORD_LENGTH = 32;
+
+struct TypoMatch {
+    std::string_view term;
+    size_t edit_count = 0;
+};
+
+// Finds indexed terms within a few typos of a word: inserted, deleted or substituted letters
+// and swapped neighbours. Uses symmetric deletion: two words are that close only if deleting at
+// most as many letters from each gives a common string, so every term is stored under the
+// fingerprints of its deletion variants and a word looks up its own. Candidates are then checked
+// with the exact edit distance, hence fingerprint collisions cost time but never give wrong
+// matches.
+//
+// Entries are 8 bytes in an open-addressing table, about 16 bytes per variant at the maximal
+// load. A term of n letters has about n variants for one typo and n^2/2 for two.
+class TypoIndex {
+public:
+    // Throws std::invalid_argument if max_edits is above 2.
+    explicit TypoIndex(size_t max_edits, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // The term must outlive the index. Adding a term twice is allowed but wastes memory.
+    void Add(std::string_view term);
+
+    // Typos a word of this spelling may have, by its length and at most max_edits.
+    size_t GetAllowedEdits(std::string_view word) const;
+
+    // Indexed terms within GetAllowedEdits(word) typos of word, each once, in no particular order.
+    std::pmr::vector<TypoMatch> FindMatches(std::string_view word, std::pmr::memory_resource* resource) const;
+
+    // Typos between word and any term, indexed or not; GetAllowedEdits(word) + 1 when there are more.
+    size_t CountTypos(std::string_view word, std::string_view term) const;
+
+private:
+    struct Entry {
+        // 0 marks a free slot.
+        std::uint32_t fingerprint = 0;
+        std::uint32_t term = 0;
+    };
+
+    size_t max_edits_;
+    std::pmr::vector<std::string_view> terms_;
+    // Size is a power of two, at most half of the slots are taken.
+    std::pmr::vector<Entry> entries_;
+    size_t entry_count_ = 0;
+
+    void Insert(Entry entry);
+};
@@ -0,0 +1,265 @@
+#include "write_ahead_log.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Record layout: payload size, CRC-32 of LSN and payload, LSN, payload.
+const size_t RECORD_HEADER_SIZE = sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t);
+
+[[noreturn]] void ThrowSystemError(const std::string& action) {
+    throw std::runtime_error(action + ": " + std::strerror(errno));
+}
+
+std::uint32_t UpdateCrc32(std::uint32_t crc, std::string_view data) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> result{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    crc = ~crc;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<std::uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::uint32_t ComputeChecksum(std::uint64_t lsn, std::string_view payload) {
+    const std::uint32_t crc = UpdateCrc32(0, std::string_view(reinterpret_cast<const char*>(&lsn), sizeof(lsn)));
+    return UpdateCrc32(crc, payload);
+}
+
+void WriteAll(int descriptor, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(descriptor, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("write");
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+}  // namespace
+
+void SyncPath(const std::string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        ThrowSystemError("open " + path);
+    }
+    const int result = fsync(descriptor);
+    close(descriptor);
+    if (result < 0) {
+        ThrowSystemError("fsync " + path);
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, std::uint64_t checkpoint_lsn, const RecordHandler& replay,
+                             const WriteAheadLogOptions& options)
+    : path_(path)
+    , options_(options)
+{
+    descriptor_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (descriptor_ < 0) {
+        ThrowSystemError("open " + path);
+    }
+
+    std::uint64_t last_lsn = checkpoint_lsn;
+    try {
+        const MappedFile file(path);
+        const std::string_view contents = file.GetContents();
+        size_t offset = 0;
+        while (contents.size() - offset >= RECORD_HEADER_SIZE) {
+            BinaryReader header(contents.substr(offset, RECORD_HEADER_SIZE));
+            const auto payload_size = header.Read<std::uint32_t>();
+            const auto checksum = header.Read<std::uint32_t>();
+            const auto lsn = header.Read<std::uint64_t>();
+            if (contents.size() - offset - RECORD_HEADER_SIZE < payload_size) {
+                break;
+            }
+            const std::string_view payload = contents.substr(offset + RECORD_HEADER_SIZE, payload_size);
+            if (ComputeChecksum(lsn, payload) != checksum) {
+                break;
+            }
+            if (lsn > checkpoint_lsn) {
+                replay(lsn, payload);
+            }
+            last_lsn = std::max(last_lsn, lsn);
+            offset += RECORD_HEADER_SIZE + payload_size;
+        }
+
+        // Whatever follows the last intact record was being written during a crash.
+        if (offset < contents.size()) {
+            if (ftruncate(descriptor_, static_cast<off_t>(offset)) < 0 || fdatasync(descriptor_) < 0) {
+                ThrowSystemError("truncate " + path);
+            }
+        }
+        file_size_ = offset;
+    }
+    catch (...) {
+        close(descriptor_);
+        throw;
+    }
+
+    next_lsn_ = last_lsn + 1;
+    durable_lsn_ = last_lsn;
+    if (!options_.sync_on_commit) {
+        flusher_ = std::thread([this] { RunFlusher(); });
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    stop_flusher_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    try {
+        Sync();
+    }
+    catch (...) {
+        // Nothing to report to from a destructor; the records stay lost as after a crash.
+    }
+    close(descriptor_);
+}
+
+std::uint64_t WriteAheadLog::Append(std::string_view payload) {
+    std::lock_guard guard(mutex_);
+    const std::uint64_t lsn = next_lsn_++;
+    AppendBinary(buffer_, static_cast<std::uint32_t>(payload.size()));
+    AppendBinary(buffer_, ComputeChecksum(lsn, payload));
+    AppendBinary(buffer_, lsn);
+    buffer_.append(payload);
+    return lsn;
+}
+
+void WriteAheadLog::WaitDurable(std::uint64_t lsn) {
+    std::unique_lock lock(mutex_);
+    while (durable_lsn_ < lsn) {
+        if (flushing_) {
+            flushed_.wait(lock);
+        }
+        else {
+            Flush(lock);
+        }
+    }
+}
+
+bool WriteAheadLog::Discard(std::uint64_t lsn) {
+    std::unique_lock lock(mutex_);
+    // A failed flush puts its records back into the buffer, a successful one makes them durable.
+    flushed_.wait(lock, [this] { return !flushing_; });
+    if (lsn <= durable_lsn_) {
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < buffer_.size()) {
+        BinaryReader header(std::string_view(buffer_).substr(offset, RECORD_HEADER_SIZE));
+        const auto payload_size = header.Read<std::uint32_t>();
+        header.Read<std::uint32_t>();
+        const size_t record_size = RECORD_HEADER_SIZE + payload_size;
+        if (header.Read<std::uint64_t>() == lsn) {
+            // Replay does not need consecutive LSNs, the gap stays.
+            buffer_.erase(offset, record_size);
+            return true;
+        }
+        offset += record_size;
+    }
+    return false;
+}
+
+void WriteAheadLog::Sync() {
+    WaitDurable(GetLastLsn());
+}
+
+void WriteAheadLog::Truncate() {
+    std::unique_lock lock(mutex_);
+    while (flushing_ || !buffer_.empty()) {
+        if (flushing_) {
+            flushed_.wait(lock);
+        }
+        else {
+            Flush(lock);
+        }
+    }
+    if (ftruncate(descriptor_, 0) < 0 || fdatasync(descriptor_) < 0) {
+        ThrowSystemError("truncate " + path_);
+    }
+    file_size_ = 0;
+}
+
+std::uint64_t WriteAheadLog::GetLastLsn() const {
+    std::lock_guard guard(mutex_);
+    return next_lsn_ - 1;
+}
+
+size_t WriteAheadLog::GetSize() const {
+    std::lock_guard guard(mutex_);
+    return file_size_ + buffer_.size();
+}
+
+void WriteAheadLog::Flush(std::unique_lock<std::mutex>& lock) {
+    flushing_ = true;
+    std::string data;
+    data.swap(buffer_);
+    const std::uint64_t last_lsn = next_lsn_ - 1;
+    lock.unlock();
+
+    try {
+        WriteAll(descriptor_, data);
+        if (fdatasync(descriptor_) < 0) {
+            ThrowSystemError("fdatasync " + path_);
+        }
+    }
+    catch (...) {
+        // Drop a partially written batch and keep its records, a retry rewrites them whole.
+        [[maybe_unused]] const int result = ftruncate(descriptor_, static_cast<off_t>(file_size_));
+        lock.lock();
+        buffer_.insert(0, data);
+        flushing_ = false;
+        flushed_.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    flushing_ = false;
+    durable_lsn_ = last_lsn;
+    file_size_ += data.size();
+    flushed_.notify_all();
+}
+
+void WriteAheadLog::RunFlusher() {
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+        stop_flusher_.wait_for(lock, options_.flush_interval);
+        if (!flushing_ && !buffer_.empty()) {
+            try {
+                Flush(lock);
+            }
+            catch (...) {
+                // Left for the next attempt; Sync surfaces a persistent failure to the caller.
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+struct WriteAheadLogOptions {
+    // true: WaitDurable blocks until the record is on disk. Writers waiting at the same time share
+    // one write and one fdatasync (group commit), so the sync cost is paid per batch, not per record.
+    // false: a background thread writes and syncs the buffered records every flush_interval, and
+    // a crash may lose the last interval; Sync still makes everything appended so far durable.
+    bool sync_on_commit = true;
+    std::chrono::milliseconds flush_interval{ 10 };
+};
+
+// Append-only log of opaque records. Every record carries a log sequence number (LSN) and a
+// checksum, so a record torn by a crash is detected and dropped on the next open.
+class WriteAheadLog {
+public:
+    using RecordHandler = std::function<void(std::uint64_t lsn, std::string_view payload)>;
+
+    // Replays the intact records with an LSN above checkpoint_lsn, cuts off a torn tail and opens
+    // the log for appending. New records continue the LSN sequence after both.
+    WriteAheadLog(const std::string& path, std::uint64_t checkpoint_lsn, const RecordHandler& replay,
+                  const WriteAheadLogOptions& options = {});
+
+    // Makes all appended records durable.
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Buffers the record and returns its LSN; nothing is written yet.
+    std::uint64_t Append(std::string_view payload);
+
+    // Throws std::runtime_error when the write or the sync fails; the records stay buffered for
+    // the next attempt.
+    void WaitDurable(std::uint64_t lsn);
+
+    // Takes back a record that is not durable yet, e.g. after WaitDurable failed. Returns false
+    // if the record is already on disk.
+    bool Discard(std::uint64_t lsn);
+
+    void Sync();
+
+    // Empties the log once a checkpoint holds every record. LSNs keep growing afterwards.
+    void Truncate();
+
+    std::uint64_t GetLastLsn() const;
+
+    // Bytes on disk plus bytes still buffered.
+    size_t GetSize() const;
+
+private:
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    int descriptor_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flushed_;
+    std::string buffer_;
+    std::uint64_t next_lsn_ = 1;
+    std::uint64_t durable_lsn_ = 0;
+    size_t file_size_ = 0;
+    bool flushing_ = false;
+
+    std::condition_variable stop_flusher_;
+    bool stopping_ = false;
+    std::thread flusher_;
+
+    // Writes and syncs the buffer with the lock released; other writers keep appending meanwhile
+    // and are covered by the next flush.
+    void Flush(std::unique_lock<std::mutex>& lock);
+
+    void RunFlusher();
+};
+
+// fsync by path: for a file it flushes the data, for a directory the creations and renames inside it.
+void SyncPath(const std::string& path);